@@ -19,8 +19,6 @@ using namespace fmt::literals;
 using namespace std::literals;
 using namespace std::literals::chrono_literals;
 
-#include <mk-wcwidth.h>
-
 namespace termic
 {
 extern std::FILE *g_log;
@@ -43,7 +41,7 @@ int main()
 //	}
 //	//fmt::print(u8"{}", std::u8string(u8"\xc3\x85"));
 
-//	fmt::print("width: {}\n", ::mk_wcwidth(0xd6));
+//	fmt::print("width: {}\n", utf8::width(0xd6));
 
 
 //	exit(1);
@@ -56,6 +54,7 @@ int main()
 	App app(HideCursor | MouseEvents);// | FocusEvents);
 
 	Screen &screen { app.screen() };
+	screen.set_recording(true);  // most of each frame is drawn over
 
 	Canvas canvas { screen };
 	color::LinearGradient gradient({
@@ -1,21 +1,17 @@
 #pragma once
 
 #include "look.h"
+#include "parallel.h"
+#include "samplers.h"
+#include "screen.h"
 #include "size.h"
 
-#include <functional>
+#include <algorithm>
+#include <span>
 
 namespace termic
 {
 
-struct Screen;
-
-namespace color
-{
-struct Sampler;
-}
-struct UV;
-
 struct Canvas
 {
 	inline Canvas(Screen &scr) : _screen(scr) {};
@@ -23,20 +19,158 @@ struct Canvas
 	void clear();
 	Size size() const;
 
+	// operations on a rectangle can be split across threads by passing 'termic::par',
+	//   in bands of rows (small rectangles are still done serially)
+
 	void fill(Color c);
 	void fill(const color::Sampler *s, float sampler_angle=0);
 	void fill(Rectangle rect, Color c);
 	void fill(Rectangle rect, const color::Sampler *s, float sampler_angle=0);
+	void fill(Rectangle rect, const color::Sampler *s, float sampler_angle, parallel_policy);
+	// translucent fill; composites 'c' on top of the background
+	void fill(Rectangle rect, color::Rgba c);
+	// composites 'fg' & 'bg' on top of the colors in 'rect'  (e.g. shadows and highlights)
+	void composite(Rectangle rect, color::Rgba fg, color::Rgba bg);
 
-	void filter(std::function<void (Look &, UV)> f);
-	void filter(Rectangle rect, std::function<void(Look &, UV)> f);
+	// call 'f(Look &, UV)' for every cell inside 'rect'
+	template<typename F>
+	void filter(F &&f);
+	template<typename F>
+	void filter(Rectangle rect, F &&f);
+	template<typename F>
+	void filter(Rectangle rect, F &&f, parallel_policy);
+	// call 'f(std::span<Cell>, UV, float du)' for every row inside 'rect';
+	//   UV is that of the first cell, 'u' of the following cells increases by 'du'
+	template<typename F>
+	void filter_rows(Rectangle rect, F &&f);
+	template<typename F>
+	void filter_rows(Rectangle rect, F &&f, parallel_policy);
 	void fade(float blend);
 	void fade(Color fg=color::Black, Color bg=color::Black, float blend=0.5f);
 	void fade(Rectangle rect, float blend=0.5f);
 	void fade(Rectangle rect, Color fg, Color bg, float blend=0.5f);
+	void fade(Rectangle rect, Color fg, Color bg, float blend, parallel_policy);
+
+	enum ImageMode : std::uint8_t
+	{
+		Background,  // one pixel per cell, as background color
+		HalfBlocks,  // two pixels per cell, as '▀' with fg & bg
+	};
+	// draw an 8-bit RGB image scaled to fit 'rect' (averaging the pixels covered by each cell).
+	//   'stride' is the number of bytes per row (0: 3*width).
+	//   scaled images are cached (by content), so drawing the same image again is cheap.
+	//   every call still reads the whole image to hash it (much less work than scaling it); an entry is only
+	//   reused if the dimensions and two independent 64-bit hashes match, so a false hit is practically impossible.
+	void blit_image(Rectangle rect, const std::uint8_t *rgb, std::size_t width, std::size_t height, std::size_t stride=0, ImageMode mode=Background);
+	// number of scaled images in the cache
+	std::size_t cached_images() const;
+
+private:
+	void fill(Rectangle rect, const color::Sampler *s, float sampler_angle, bool parallel);
+	void fade(Rectangle rect, Color fg, Color bg, float blend, bool parallel);
+	template<typename F>
+	void filter_rows(Rectangle rect, F &&f, bool parallel);
+	template<typename F>
+	static auto cells_of(F &f);
+
+	// the on-screen part of 'rect'  (an empty 'rect' counts as a single cell)
+	Rectangle clipped(Rectangle &rect) const;
+	// call 'f(first, last)' for bands of the rows [0, area.height), in parallel if asked to (and it's worth it)
+	template<typename F>
+	void for_bands(Rectangle area, bool parallel, F &&f);
+
+	// fewer cells than this per thread isn't worth the synchronization
+	static constexpr std::size_t min_parallel_cells { 4096 };
 
 private:
 	Screen &_screen;
 };
 
+template<typename F>
+void Canvas::filter(F &&f)
+{
+	filter(_screen.rect(), std::forward<F>(f));
+}
+
+template<typename F>
+void Canvas::filter(Rectangle rect, F &&f)
+{
+	filter_rows(rect, cells_of(f), false);
+}
+
+template<typename F>
+void Canvas::filter(Rectangle rect, F &&f, parallel_policy)
+{
+	filter_rows(rect, cells_of(f), true);
+}
+
+template<typename F>
+void Canvas::filter_rows(Rectangle rect, F &&f)
+{
+	filter_rows(rect, std::forward<F>(f), false);
+}
+
+template<typename F>
+void Canvas::filter_rows(Rectangle rect, F &&f, parallel_policy)
+{
+	filter_rows(rect, std::forward<F>(f), true);
+}
+
+// adapts a per-cell filter to a per-row one  (keeps a copy of 'f', in case it's recorded)
+template<typename F>
+auto Canvas::cells_of(F &f)
+{
+	return [f](std::span<Cell> cells, UV uv, float du) {
+		const auto u0 = uv.u;
+		for(std::size_t idx = 0; idx < cells.size(); ++idx)
+		{
+			uv.u = std::min(1.f, u0 + float(idx)*du);
+			f(cells[idx].look, uv);
+		}
+	};
+}
+
+template<typename F>
+void Canvas::filter_rows(Rectangle rect, F &&f, bool parallel)
+{
+	if(_screen._recording)
+	{
+		_screen._draw_list.filter(rect, DrawList::RowFilter(std::forward<F>(f)), parallel);
+		_screen.invalidate();
+		return;
+	}
+
+	const auto area = clipped(rect);
+
+	// UV is still relative to the whole (unclipped) rectangle
+	const auto du = 1.f / float(rect.size.width);
+	const auto dv = 1.f / float(rect.size.height);
+	const auto u0 = float(area.top_left.x - rect.top_left.x + 1)*du;
+	const auto row0 = area.top_left.y - rect.top_left.y;
+
+	auto &buffer = _screen._back_buffer;
+
+	for_bands(area, parallel, [&](std::size_t first, std::size_t last) {
+		for(auto row = first; row < last; ++row)
+		{
+			const UV uv { u0, std::min(1.f, float(row0 + row + 1)*dv) };
+			f(buffer.span({ area.top_left.x, area.top_left.y + row }, area.size.width), uv, du);
+		}
+	});
+}
+
+template<typename F>
+void Canvas::for_bands(Rectangle area, bool parallel, F &&f)
+{
+	if(area.size.width == 0 or area.size.height == 0)
+		return;
+
+	if(parallel)
+		parallel::for_bands(area.size.height, min_parallel_cells/area.size.width, f);
+	else
+		f(0ul, area.size.height);
+
+	_screen.invalidate();
+}
+
 } // NS: termic
@@ -2,7 +2,9 @@
 
 #include <termic/look.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <fmt/core.h>
 #include <string_view>
 
@@ -18,7 +20,42 @@ struct Cell
 		return look == other.look and width == other.width and std::strncmp(ch, other.ch, sizeof(ch)) == 0;
 	}
 
-	char ch[5]   { '\0' };     // a single UTF-8 character, null-terminated  (max utf-8 bytes is 4)
+	// as much of 'cluster' as fits in a cell, in whole codepoints
+	static inline std::string_view fitting(std::string_view cluster)
+	{
+		if(cluster.size() < sizeof(ch))
+			return cluster;
+
+		auto len = sizeof(ch) - 1;
+		while(len > 0 and (static_cast<std::uint8_t>(cluster[len]) & 0xc0) == 0x80)
+			--len;
+
+		return cluster.substr(0, len);
+	}
+
+	// set the content (unless it's 'NoChange'; see fitting()), the width and the parts of the look that aren't 'NoChange'
+	inline void set(std::string_view content, std::size_t w, Look lk)
+	{
+		if(content != NoChange)
+		{
+			content = fitting(content);
+			std::copy_n(content.data(), content.size(), ch);
+			ch[content.size()] = '\0';
+		}
+
+		width = static_cast<std::uint_fast8_t>(w);
+
+		if(lk.fg != color::NoChange)
+			look.fg = lk.fg;
+
+		if(lk.style != style::NoChange)
+			look.style = lk.style;
+
+		if(lk.bg != color::NoChange)
+			look.bg = lk.bg;
+	}
+
+	char ch[15]  { '\0' };     // a grapheme cluster (UTF-8), null-terminated; longer ones are cut short
 	std::uint_fast8_t width;
 	Look look;
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "look.h"
+#include "samplers.h"
+#include "size.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace termic
+{
+
+struct ScreenBuffer;
+
+// drawing commands, recorded to be drawn later in one go.
+//   when played back, work whose result is entirely overwritten by later commands is skipped (per cell),
+//   and consecutive row operations (fill/filter/fade) on the same rectangle are done in a single pass.
+struct DrawList
+{
+	using RowFilter = std::function<void (std::span<Cell>, UV, float)>;
+
+	inline bool empty() const { return _commands.empty(); }
+
+	void clear(Rectangle rect, Color bg, Color fg);
+	void fill(Rectangle rect, Color c);
+	// 's' is used when playing back; it must still exist (and not be changed) by then
+	void fill(Rectangle rect, const color::Sampler *s, float angle, bool parallel);
+	void filter(Rectangle rect, RowFilter f, bool parallel);
+	void fade(Rectangle rect, Color fg, Color bg, float blend, bool parallel);
+	void composite(Rectangle rect, color::Rgba fg, color::Rgba bg);
+	void print(Pos pos, std::string_view s, Look lk);
+
+	// draw everything recorded into 'buffer' (in order), then forget it
+	void play(ScreenBuffer &buffer);
+	// forget everything recorded
+	void discard();
+
+private:
+	struct Clear     { Rectangle rect; Color bg; Color fg; };
+	struct Fill      { Rectangle rect; Color c; };
+	struct Sample    { Rectangle rect; const color::Sampler *sampler; float angle; bool parallel; };
+	struct Filter    { Rectangle rect; RowFilter f; bool parallel; };
+	struct Fade      { Rectangle rect; Color fg; Color bg; float blend; bool parallel; };
+	struct Composite { Rectangle rect; color::Rgba fg; color::Rgba bg; };
+	struct Print     { Pos pos; std::string text; Look lk; };
+
+	using Command = std::variant<Clear, Fill, Sample, Filter, Fade, Composite, Print>;
+
+	// the cell fields a command may set
+	enum Field : std::uint8_t
+	{
+		Content = 1 << 0,  // character & width
+		Fg      = 1 << 1,
+		Bg      = 1 << 2,
+		Style   = 1 << 3,
+	};
+	static constexpr std::size_t num_fields { 4 };
+
+	static std::uint8_t covers(const Command &cmd);
+	static std::uint8_t writes(const Command &cmd);
+	static bool reads(const Command &cmd);
+
+	void cover(std::size_t index, std::uint8_t fields, std::size_t cell);
+	bool live(std::size_t index, std::uint8_t fields, std::size_t cell) const;
+	bool live(std::size_t index, const Command &cmd, const ScreenBuffer &buffer) const;
+	void play_rows(std::size_t first, std::size_t last, ScreenBuffer &buffer);
+
+private:
+	std::vector<Command> _commands;
+
+	// per field & cell: the (1-based) index of the last command that completely sets it
+	std::vector<std::uint32_t> _set_by[num_fields];
+	// per cell: the (1-based) index of the last command that uses its previous values (so far, in the first pass)
+	std::vector<std::uint32_t> _read_by;
+	// per field & cell: '_read_by' when it was last set  (writes before that are used)
+	std::vector<std::uint32_t> _read_before[num_fields];
+	std::size_t _stride { 0 };
+};
+
+} // NS: termic
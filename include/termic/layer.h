@@ -0,0 +1,67 @@
+#pragma once
+
+#include "cell.h"
+#include "screen-buffer.h"
+#include "size.h"
+
+#include <string_view>
+
+
+namespace termic
+{
+
+// an overlay (e.g. a popup or a tooltip) composited on top of the screen content.
+//   cells that haven't been drawn to are transparent; cell properties set to NoChange let the content below show through.
+//   drawing functions use layer-local coordinates.
+struct Layer
+{
+	inline Rectangle rect() const { return { _pos, _buffer.size() }; }
+	inline Size size() const { return _buffer.size(); }
+	inline int z() const { return _z; }
+	inline bool visible() const { return _visible; }
+	inline float opacity() const { return float(_alpha)/255.f; }
+
+	void move(Pos top_left);
+	void set_visible(bool visible);
+	// colors of the layer are composited with this opacity [0, 1]  (characters are always opaque)
+	void set_opacity(float opacity);
+
+	// make all cells transparent
+	void clear();
+	void clear(Color bg, Color fg=color::NoChange);
+	void clear(Rectangle rect, Color bg, Color fg=color::NoChange);
+	void set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk=look::Default);
+	std::size_t print(Pos pos, std::string_view s, Look lk=look::Default);
+	void blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos={ 0, 0 });
+
+	// mark the whole layer as changed
+	void invalidate();
+
+	static const Cell transparent;
+
+private:
+	friend struct Screen;
+
+	Layer(Rectangle rect, int z);
+
+	void damage(Rectangle rect);
+	void expose(Rectangle screen_rect);
+	// the area of the screen that needs to be recomposited (zero size if none)
+	Rectangle screen_damage() const;
+
+	// composite the part of this layer inside 'area' (screen coordinates) on to 'dst'.
+	//   double-width characters that end up split are left for the caller to fix (see ScreenBuffer::fix_wide_cells())
+	void composite(ScreenBuffer &dst, Rectangle area) const;
+
+private:
+	ScreenBuffer _buffer;
+	Pos _pos;
+	int _z { 0 };
+	bool _visible { true };
+	std::uint32_t _alpha { 255 };
+
+	Rectangle _damage { { 0, 0 }, { 0, 0 } };  // layer coordinates
+	Rectangle _exposed { { 0, 0 }, { 0, 0 } }; // screen coordinates; e.g. where the layer was before it was moved
+};
+
+} // NS: termic
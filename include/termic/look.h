@@ -62,6 +62,73 @@ constexpr inline Color rgb(std::uint8_t r, std::uint8_t g, std::uint8_t b)
 
 Color lerp(Color a, Color b, float blend);
 
+// the channels of a color in 16-bit lanes of a 64-bit word (and back), to blend all of them at once
+constexpr inline std::uint64_t spread(Color c)
+{
+	return (c & 0xff) | (std::uint64_t(c & 0xff00) << 8) | (std::uint64_t(c & 0xff0000) << 16);
+}
+constexpr inline Color unspread(std::uint64_t m)
+{
+	return Color((m & 0xff) | ((m >> 8) & 0xff00) | ((m >> 16) & 0xff0000));
+}
+static constexpr std::uint64_t spread_lanes { 0x00ff'00ff'00ff };
+
+// c*a/255 (rounded), for each channel
+constexpr inline Color scale(Color c, std::uint32_t a)
+{
+	const auto m = spread(c)*a + 0x0080'0080'0080;
+	return unspread(((m + ((m >> 8) & spread_lanes)) >> 8) & spread_lanes);
+}
+
+// blend 'a' towards 'b' by 'weight'/256, in 8-bit fixed point  (special colors count as black)
+constexpr inline Color mix(Color a, Color b, std::uint32_t weight)
+{
+	// 255*256 fits in a lane, so there's no carry between channels
+	return unspread(((spread(a)*(256 - weight) + spread(b)*weight) >> 8) & spread_lanes);
+}
+
+// 'blend' [0, 1] as a weight for mix()
+constexpr inline std::uint32_t mix_weight(float blend)
+{
+	return static_cast<std::uint32_t>((blend < 0.f? 0.f: blend > 1.f? 1.f: blend)*256.f + 0.5f);
+}
+
+// a color with an opacity.  the channels are premultiplied by it, so compositing is a single multiply-add.
+//   special colors can't be blended: NoChange is fully transparent, Default counts as black (unless opaque)
+struct Rgba
+{
+	Color c;         // premultiplied
+	std::uint32_t a; // 0 - 255
+};
+
+// 'a' is the opacity 0 - 255
+constexpr inline Rgba with_alpha(Color c, std::uint32_t a)
+{
+	if(c == NoChange or a == 0)
+		return { 0, 0 };
+	if(a >= 255)
+		return { c, 255 };
+
+	return { scale(c, a), a };
+}
+
+constexpr inline Rgba rgba(Color c, float opacity)
+{
+	return with_alpha(c, static_cast<std::uint32_t>((opacity < 0.f? 0.f: opacity > 1.f? 1.f: opacity)*255.f + 0.5f));
+}
+
+// 'src' composited on top of 'dst'
+constexpr inline Color over(Rgba src, Color dst)
+{
+	if(src.a == 255)
+		return src.c;
+	if(src.a == 0)
+		return dst;
+
+	// with premultiplied channels the sum can't exceed 255
+	return unspread(spread(src.c) + spread(scale(dst, 255 - src.a)));
+}
+
 } // NS: color
 
 inline std::string escify(Color c)
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace termic
+{
+
+// execution policies for bulk drawing operations
+struct sequenced_policy {};
+struct parallel_policy {};
+
+inline constexpr sequenced_policy seq {};
+inline constexpr parallel_policy par {};
+
+namespace parallel
+{
+
+// calls 'f(first, last)' for consecutive bands of the rows [0, count), at least 'min_band' rows each,
+//   on a persistent pool of worker threads (and the calling thread). returns when all bands are done.
+//   runs serially if there's only one band (or the pool has no workers).
+void for_bands(std::size_t count, std::size_t min_band, const std::function<void (std::size_t, std::size_t)> &f);
+
+// number of threads for_bands() uses, including the calling thread
+std::size_t concurrency();
+// use 'threads' (including the calling thread) from now on, regardless of the hardware, e.g. for testing; 0 for the default
+void set_concurrency(std::size_t threads);
+
+} // NS: parallel
+
+} // NS: termic
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "look.h"
+#include "size.h"
+
+
+namespace termic
+{
+
+struct ScreenBuffer;
+
+// a framebuffer with more than one pixel per cell, for charts and images.
+//   HalfBlock: 1x2 pixels per cell, drawn as '▀' with the top pixel as fg and the bottom as bg.
+//   Braille:   2x4 pixels per cell, drawn as braille patterns; pixels brighter than the cell's average are dots,
+//              the two groups of pixels are averaged into fg & bg.
+//   only cells whose pixels changed are converted when drawing (see draw()).
+struct PixelCanvas
+{
+	enum Mode : std::uint8_t
+	{
+		HalfBlock,
+		Braille,
+	};
+
+	// 'cells' is the size in cells; discards all content
+	PixelCanvas(Size cells={ 0, 0 }, Mode mode=HalfBlock);
+	void set_size(Size cells);
+
+	inline Mode mode() const { return _mode; }
+	// size in pixels
+	inline Size size() const { return { _width, _height }; }
+	// size in cells
+	inline Size cell_size() const { return { _width / _cell_width, _height / _cell_height }; }
+
+	void clear(Color c=color::Black);
+
+	inline Color pixel(Pos pos) const { return _pixels[pos.y*_width + pos.x]; }
+	inline void set_pixel(Pos pos, Color c)
+	{
+		if(pos.x >= _width or pos.y >= _height)
+			return;
+
+		auto &p = _pixels[pos.y*_width + pos.x];
+		if(p != c)
+		{
+			p = c;
+			_dirty[(pos.y / _cell_height)*(_width / _cell_width) + pos.x / _cell_width] = 1;
+		}
+	}
+	void fill(Rectangle rect, Color c);
+	// a row of pixels, for bulk writes; the cells it touches are considered changed  (empty if 'y' is outside)
+	std::span<Color> row(std::size_t y);
+
+	// convert the changed cells to characters in 'dst', with the top left corner at 'dst_pos'.
+	//   drawing to a different buffer or position, or after a full clear of 'dst', converts all cells;
+	//   call invalidate() if the area was drawn over in other ways.
+	void draw(ScreenBuffer &dst, Pos dst_pos={ 0, 0 });
+	// consider all cells changed
+	void invalidate();
+
+private:
+	void draw_half_blocks(ScreenBuffer &dst, Pos dst_pos, std::size_t cy, bool all);
+	void draw_braille(ScreenBuffer &dst, Pos dst_pos, std::size_t cy, bool all);
+
+private:
+	Mode _mode;
+	std::size_t _cell_width;
+	std::size_t _cell_height;
+
+	std::vector<Color> _pixels;
+	std::vector<std::uint8_t> _dirty;  // per cell
+	std::size_t _width { 0 };
+	std::size_t _height { 0 };
+	std::vector<std::uint32_t> _luma;  // scratch, for draw_braille()
+
+	// where it was drawn last time
+	const ScreenBuffer *_drawn_to { nullptr };
+	Pos _drawn_pos { 0, 0 };
+	std::uint64_t _drawn_generation { 0 };
+};
+
+} // NS: termic
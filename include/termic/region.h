@@ -0,0 +1,81 @@
+#pragma once
+
+#include "cell.h"
+#include "screen-buffer.h"
+#include "size.h"
+
+#include <string_view>
+
+
+namespace termic
+{
+
+enum Alignment
+{
+	Left = 0,
+	Center,
+	Right
+};
+
+// a position or a length, relative to the size of the parent: 'fraction' of it plus 'offset' cells
+struct Extent
+{
+	float fraction { 0 };
+	int offset { 0 };
+
+	std::size_t resolve(std::size_t parent) const;
+};
+
+// a rectangle whose position and size are relative to its parent's size, i.e. it follows resizes
+struct Geometry
+{
+	Extent x;
+	Extent y;
+	Extent width  { 1.f };
+	Extent height { 1.f };
+
+	Rectangle resolve(Size parent) const;
+};
+
+// a view of a part of a ScreenBuffer, with its own coordinate system and cursor.
+//   nothing outside the region is ever touched.
+//   regions that don't share any rows can be drawn in from multiple threads at the same time.
+struct Region
+{
+	Region(ScreenBuffer &buffer);
+	Region(ScreenBuffer &buffer, Rectangle rect);
+
+	// sub-regions (always clipped to this region)
+	Region region(Rectangle rect) const;
+	Region region(const Geometry &geometry) const;
+
+	// the region's area in the buffer
+	inline Rectangle rect() const { return _rect; }
+	inline Size size() const { return _rect.size; }
+
+	inline void clear() { clear(color::Default, color::Default); }
+	void clear(Color bg, Color fg=color::NoChange);
+	void clear(Rectangle rect, Color bg, Color fg=color::NoChange);
+
+	void go_to(Pos pos);
+	inline std::size_t print(std::string_view s, Look lk=look::Default)
+	{
+		return print(_cursor, s, lk);
+	}
+	std::size_t print(Alignment align, Pos anchor_pos, std::string_view s, Look lk=look::Default);
+	std::size_t print(Pos pos, std::string_view s, Look lk=look::Default);
+
+	void set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk=look::Default);
+
+private:
+	// region -> buffer coordinates
+	inline Pos to_buffer(Pos pos) const { return { _rect.top_left.x + pos.x, _rect.top_left.y + pos.y }; }
+	inline Rectangle to_buffer(Rectangle rect) const { return { to_buffer(rect.top_left), rect.size }; }
+
+private:
+	ScreenBuffer &_buffer;
+	Rectangle _rect;
+	Pos _cursor { 0, 0 };
+};
+
+} // NS: termic
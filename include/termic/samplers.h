@@ -20,6 +20,8 @@ namespace color
 struct Sampler
 {
 	virtual Color sample(UV uv, float angle=0) const = 0;
+	// sample 'count' points along a row, i.e. at u = u0 + n*du
+	virtual void sample_row(float v, float u0, float du, std::size_t count, Color *out, float angle=0) const;
 };
 
 struct Constant : public Sampler
@@ -27,6 +29,8 @@ struct Constant : public Sampler
 	inline Constant(Color c) : _c(c) {};
 
 	inline Color sample(UV, float) const override { return _c; }
+	void sample_row(float v, float u0, float du, std::size_t count, Color *out, float angle) const override;
+	inline Color color() const { return _c; }
 
 private:
 	Color _c;
@@ -39,11 +43,25 @@ struct LinearGradient : public Sampler
 	void set_offset(float offset);
 
 	Color sample(UV uv, float angle) const override;
+	void sample_row(float v, float u0, float du, std::size_t count, Color *out, float angle) const override;
+
+protected:
+	// the color at 'alpha' along the gradient, from the lookup table
+	Color color_at(float alpha, float scale) const;
+	// the exact color at 't' [0, 1]; the lookup table is within one step of this (per channel)
+	Color interpolate(float t) const;
+
+	static constexpr std::size_t lut_size { 1024 };
 
 private:
+	struct Direction;
+
+private:
+
 	Color _colors[16];
 	std::size_t _num_colors;
 	float _offset { 0 };
+	std::vector<Color> _lut;  // colors along the gradient, t = [0, 1]
 };
 
 } // NS: color
@@ -2,6 +2,10 @@
 
 #include <vector>
 #include <memory>
+#include <functional>
+#include <span>
+
+#include <assert.h>
 
 #include "cell.h"
 #include "size.h"
@@ -14,29 +18,91 @@ struct ScreenBuffer
 {
 	void set_size(Size size);
 	inline Size size() const { return { _width, _height }; };
+	// changes with every full clear (all content is discarded)
+	inline std::uint64_t generation() const { return _generation; }
 
 	inline void clear(bool content=true) { clear(color::Default, color::Default, content); }
 	void clear(Color bg, Color fg=color::NoChange, bool content=true);
 	void clear(Rectangle rect, Color bg, Color fg=color::NoChange, bool content=true);
+	// set all cells to exactly 'blank'
+	void clear(const Cell &blank);
 
 	inline Cell &cell(Pos pos)
 	{
+		touch_row(pos.y);
 		return _buffer[pos.y*_width + pos.x];
 	}
 	inline const Cell &cell(Pos pos) const
 	{
+		if(_row_generation[pos.y] != _generation)  // row was cleared since it was last written
+			return _blank;
 		return _buffer[pos.y*_width + pos.x];
 	}
 	void set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk=look::Default);
+	// 'count' consecutive cells of a row, for bulk writes  (must be entirely inside the buffer)
+	inline std::span<Cell> span(Pos pos, std::size_t count)
+	{
+		assert(pos.y < _height and pos.x + count <= _width);
+		touch_row(pos.y);
+		return { _buffer.data() + pos.y*_width + pos.x, count };
+	}
+	// after bulk writes to a span: blank out halves of double-width characters that were split by its edges
+	void fix_wide_edges(Pos pos, std::size_t count);
+	// blank out halves of double-width characters anywhere in a span (and its neighbours)
+	void fix_wide_cells(Pos pos, std::size_t count);
+	// same as set_cell() on every cell inside 'rect'
+	void set_cells(Rectangle rect, std::string_view ch, std::size_t width, Look lk=look::Default);
+
+	// blend the colors of all cells inside 'rect' towards 'fg' and 'bg' by 'blend' [0, 1]  (NoChange leaves that color as is)
+	void fade(Rectangle rect, Color fg, Color bg, float blend);
+	// composite 'fg' and 'bg' on top of the colors of all cells inside 'rect'
+	void composite(Rectangle rect, color::Rgba fg, color::Rgba bg);
+
+	// print 's' starting at 'pos', returns the width of the widest line printed.
+	//   if 'end' is given, it's set to the position following the printed text
+	std::size_t print(Pos pos, std::string_view s, Look lk=look::Default, Pos *end=nullptr);
+	// same, but only cells inside 'clip' are written  (tab stops are relative to its left edge)
+	std::size_t print(Rectangle clip, Pos pos, std::string_view s, Look lk=look::Default, Pos *end=nullptr);
+	// lay out 's' exactly like print() but don't write anything; 'f' is called with each cell that would be written
+	std::size_t dry_print(Rectangle clip, Pos pos, std::string_view s, const std::function<void (Pos)> &f={}, Pos *end=nullptr) const;
+
+	// copy the cells in 'src_rect' of 'src' to this buffer, with the top left corner at 'dst_pos' (clipped to both buffers)
+	//   'src' may be this buffer, even if the areas overlap
+	void blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos={ 0, 0 });
+	// same, but composite the colors with 'opacity'; characters are copied only from cells that have any
+	void blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos, float opacity);
 
 	ScreenBuffer &operator = (const ScreenBuffer &that);
 
 	// if true, set_size() attempts to preserve existing content
 	bool preserve_content { false };
 
+private:
+	template<typename Sink>
+	std::size_t layout(Rectangle clip, Pos pos, std::string_view s, Sink &sink, Pos *end) const;
+
+	template<typename CopyRow>
+	void blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos, CopyRow copy);
+	struct Fill;
+	void fill(Rectangle rect, const Fill &f);
+
+	// a full clear only bumps '_generation' and stores the cleared cell in '_blank';
+	//   rows are filled with '_blank' when they're first written to afterwards
+	inline void touch_row(std::size_t y)
+	{
+		if(_row_generation[y] != _generation)
+			materialize_row(y);
+	}
+	void materialize_row(std::size_t y);
+	void materialize();
+
 private:
 	std::vector<Cell> _buffer;
 
+	std::vector<std::uint64_t> _row_generation;
+	std::uint64_t _generation { 0 };
+	Cell _blank {};
+
 	std::size_t _width { 0 };
 	std::size_t _height { 0 };
 };
@@ -1,41 +1,29 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #include "cell.h"
+#include "draw-list.h"
+#include "layer.h"
+#include "pixel-canvas.h"
+#include "region.h"
 #include "screen-buffer.h"
 #include "size.h"
+#include "text.h"
+#include "tiled-buffer.h"
 
 namespace termic
 {
 
-enum Alignment
-{
-	Left = 0,
-	Center,
-	Right
-};
-
-//struct RegionI
-//{
-//  virtual Rectangle rect() const = 0;
-//	virtual inline void clear() = 0;
-//	virtual void clear(Color bg, Color fg=color::NoChange) = 0;
-//	virtual void clear(const Rectangle &rect, Color bg, Color fg=color::NoChange) = 0;
-
-//	virtual void go_to(Pos pos) = 0;
-//	virtual std::size_t print(std::string_view s, Color fg=color::Default, Color bg=color::NoChange, Style style=style::Default) = 0;
-//	virtual std::size_t print(Alignment align, Pos anchor_pos, std::string_view s, Color fg=color::Default, Color bg=color::NoChange, Style style=style::Default) = 0;
-//	virtual std::size_t print(Pos pos, std::string_view s, Color fg=color::Default, Color bg=color::NoChange, Style style=style::Default) = 0;
-//};
-
-//struct Region;
-
-struct Screen //: public RegionI
+struct Screen
 {
 	Screen(int fd);
 
-//	Region region(Rectangle rect) const; // TODO: what about resizing? need to be able to define position/size as fixed or percentage of parent
+	// a view of a part of the screen; the screen is considered changed  (use 'Geometry' to follow resizes)
+	Region region(Rectangle rect);
+	Region region(const Geometry &geometry);
 	void invalidate();
 
 	inline void clear()  { clear(color::Default, color::Default); }
@@ -51,8 +39,27 @@ struct Screen //: public RegionI
 	std::size_t print(Pos pos, std::string_view s, Look lk=look::Default);
 	std::size_t print(Pos pos, std::size_t wrap_width, std::string_view s, Look lk=look::Default);
 
+	// copy the part 'src_rect' of an off-screen buffer to 'dst_pos'
+	void blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos={ 0, 0 });
+	// same, but composite the colors with 'opacity' [0, 1]
+	void blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos, float opacity);
+	// show the part 'src_rect' of a (larger) virtual canvas at 'dst_pos'
+	void blit(const TiledBuffer &src, Rectangle src_rect, Pos dst_pos={ 0, 0 });
+
+	// convert the (changed) pixels of 'src' to cells at 'dst_pos'
+	void draw(PixelCanvas &src, Pos dst_pos={ 0, 0 });
+
+	// overlays, composited on top of the content when updating (higher 'z' is on top)
+	Layer &add_layer(Rectangle rect, int z=1);
+	void remove_layer(const Layer &layer);
+
 	void update();
 
+	// while recording, clearing, printing and canvas drawing are deferred until update() (see DrawList).
+	//   direct access to the content (regions, blits) first draws what has been recorded so far.
+	void set_recording(bool on);
+	inline bool recording() const { return _recording; }
+
 	void set_size(Size size);
 	inline Size size() const { return _back_buffer.size(); }
 	inline Rectangle rect() const { return { { 0, 0 }, size() }; }
@@ -60,6 +67,8 @@ struct Screen //: public RegionI
 	std::size_t measure(std::string_view s) const;
 
 	Cell pick(Pos pos) const;
+	// the cell as it was last output by update(), i.e. composited with the layers
+	Cell shown(Pos pos) const;
 
 private:
 	friend struct Canvas;  // direct access to internals
@@ -73,6 +82,8 @@ private:
 	void cursor_style(Style style);
 	void cursor_set_look(Look lk);
 
+	void play();
+	Rectangle compose();
 	void _out(const std::string_view text);
 	void flush_buffer();
 
@@ -81,9 +92,37 @@ private:
 	Pos _client_cursor { 0, 0 };
 
 	ScreenBuffer _back_buffer;
-	ScreenBuffer _front_buffer; // are multiple layers needed also here?
+	ScreenBuffer _front_buffer;
 	bool _dirty { false };
 
+	DrawList _draw_list;
+	bool _recording { false };
+
+	// recently scaled images, for Canvas::blit_image()  (most recently used last)
+	struct ImageKey
+	{
+		std::size_t width;      // of the source image
+		std::size_t height;
+		Size scaled;
+		std::uint64_t hash[2];  // two independent hashes of the pixels
+	};
+	struct ScaledImage
+	{
+		ImageKey key;
+		std::vector<Color> pixels;
+	};
+	std::vector<ScaledImage> _image_cache;
+
+	// for wrapped prints; the same paragraphs tend to be printed every frame
+	text::LayoutCache _layout_cache;
+	// for measure() & aligned prints; likewise the same labels
+	mutable text::WidthCache _width_cache;
+
+	std::vector<std::unique_ptr<Layer>> _layers;  // sorted by z
+	ScreenBuffer _composed_buffer;                // back buffer + layers
+	bool _composed_stale { true };
+	Rectangle _exposed { { 0, 0 }, { 0, 0 } };    // areas previously covered by removed layers
+
 	struct Cursor
 	{
 		Pos position { 0, 0 };
@@ -94,23 +133,4 @@ private:
 	const int _fd { 0 };
 };
 
-//struct Region : public RegionI
-//{
-//	void clear() override;
-//	void clear(Color bg, Color fg) override;
-//	void clear(const Rectangle &rect, Color bg, Color fg) override;
-//	void go_to(Pos pos) override;
-//	std::size_t print(std::string_view s, Color fg, Color bg, Style style) override;
-//	std::size_t print(Alignment align, Pos anchor_pos, std::string_view s, Color fg, Color bg, Style style) override;
-//	std::size_t print(Pos pos, std::string_view s, Color fg, Color bg, Style style) override;
-
-//private:
-//	Region(Screen &screen, Rectangle rect);
-
-//private:
-//	Screen &_screen;
-//	Rectangle _rect;
-//};
-
-
 } // NS: termic
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <utility>
 
@@ -40,6 +41,11 @@ struct Pos
 	std::size_t x;
 	std::size_t y;
 
+	inline bool operator == (const Pos &t) const
+	{
+		return t.x == x and t.y == y;
+	}
+
 	inline Pos move(std::pair<int, int> delta) const
 	{
 		return {
@@ -54,6 +60,11 @@ struct Rectangle
 	Pos top_left;
 	Size size;
 
+	inline bool operator == (const Rectangle &t) const
+	{
+		return t.top_left == top_left and t.size == size;
+	}
+
 	inline bool contains(Pos pos) const
 	{
 		return pos.x >= top_left.x and pos.x < (top_left.x + size.width) and pos.y >= top_left.y and pos.y < (top_left.y + size.height);
@@ -83,6 +94,36 @@ struct Rectangle
 	{
 		return top_left.x + size.width - 1;
 	}
+
+	// the area covered by both rectangles (zero size if they don't overlap)
+	inline Rectangle intersected(const Rectangle &other) const
+	{
+		const auto left = std::max(top_left.x, other.top_left.x);
+		const auto top = std::max(top_left.y, other.top_left.y);
+		const auto right = std::min(top_left.x + size.width, other.top_left.x + other.size.width);
+		const auto bottom = std::min(top_left.y + size.height, other.top_left.y + other.size.height);
+
+		if(right <= left or bottom <= top)
+			return { { left, top }, { 0, 0 } };
+
+		return { { left, top }, { right - left, bottom - top } };
+	}
+
+	// the smallest rectangle covering both rectangles
+	inline Rectangle united(const Rectangle &other) const
+	{
+		if(area() == 0)
+			return other;
+		if(other.area() == 0)
+			return *this;
+
+		const auto left = std::min(top_left.x, other.top_left.x);
+		const auto top = std::min(top_left.y, other.top_left.y);
+		const auto right = std::max(top_left.x + size.width, other.top_left.x + other.size.width);
+		const auto bottom = std::max(top_left.y + size.height, other.top_left.y + other.size.height);
+
+		return { { left, top }, { right - left, bottom - top } };
+	}
 };
 
 
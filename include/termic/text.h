@@ -1,5 +1,14 @@
 #pragma once
 
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <span>
+#include <tuple>
+#include <unordered_map>
+#include <memory>
 #include <string_view>
 #include <vector>
 #include <fmt/core.h>
@@ -14,13 +23,341 @@ namespace text
 
 enum BreakMode  // https://unicode.org/reports/tr14/#BreakOpportunities
 {
-	WesternBreaks,
-	EastAsianBreaks,
-	SouthEastAsianBreaks,
+	WesternBreaks,         // ambiguous characters are alphabetic, no breaks before small kana
+	EastAsianBreaks,       // ambiguous characters & small kana are ideographic (can be broken around)
+	SouthEastAsianBreaks,  // Thai, Lao, etc. can be broken between any two letters (there's no dictionary)
 };
 
+// finds line break opportunities (UAX #14), one codepoint at a time.
+//   rules between two characters are looked up in a pair table; the few that need more context
+//   (combining marks, spaces, Hebrew hyphens, regional indicator pairs) are tracked as they pass. no backtracking.
+struct LineBreaker
+{
+	enum Break : std::uint8_t
+	{
+		NoBreak,
+		Allowed,
+		Mandatory,
+	};
+
+	explicit inline LineBreaker(BreakMode brmode=WesternBreaks) : _brmode(brmode) {}
+
+	// whether a line can (or must) be broken before 'codepoint', following those passed before
+	Break next(char32_t codepoint);
+	// as at the start of a text
+	inline void reset() { *this = LineBreaker(_brmode); }
+
+private:
+	BreakMode _brmode;
+	utf8::LineBreak _before { utf8::LineBreak::AL };  // the last character, except spaces & attached marks
+	bool _start { true };
+	bool _spaces { false };      // since '_before'
+	bool _after_zwj { false };
+	bool _hebrew_hyphen { false };
+	std::uint32_t _regional_indicators { 0 };  // in a row, up to '_before'
+};
+
+// whether 'codepoint' ends a line (and should not be shown)
+inline bool is_line_end(char32_t codepoint)
+{
+	const auto lb = utf8::line_break(codepoint);
+	return lb == utf8::LineBreak::BK or lb == utf8::LineBreak::CR or lb == utf8::LineBreak::LF or lb == utf8::LineBreak::NL;
+}
+
+// display width of 's', in cells, as printed (by grapheme clusters)
+std::size_t width(std::string_view s);
+
+// a line of wrapped text
+struct Line
+{
+	std::size_t start { 0 };  // byte offsets, into the wrapped string
+	std::size_t end   { 0 };
+	std::size_t width { 0 };  // in cells, including the hyphen
+	bool hyphen { false };    // a word was cut; a '-' should be drawn after it
+};
+
+// display width of a codepoint, in cells
+struct CellWidth
+{
+	inline int operator () (char32_t codepoint) const { return utf8::width(codepoint); }
+};
+
+// the lines of 's' wrapped to at most 'limit' cells, computed one at a time (no allocations).
+//   lines are broken where LineBreaker allows it, leaving out spaces at the ends, and at line ends (e.g. newlines);
+//   words too long for a line are cut, with a hyphen if 'limit' is at least 3.
+template<typename CharWidth=CellWidth>
+struct Lines
+{
+	struct iterator
+	{
+		inline const Line &operator * () const { return _line; }
+		inline const Line *operator -> () const { return &_line; }
+		inline iterator &operator ++ () { _done = not _lines->next(_line); return *this; }
+		inline bool operator == (std::default_sentinel_t) const { return _done; }
+
+		Lines *_lines;
+		Line _line {};
+		bool _done { false };
+	};
+
+	inline Lines(std::string_view s, std::size_t limit, BreakMode brmode=WesternBreaks, CharWidth char_width={}) :
+		_s(s),
+		_limit(std::max(1ul, limit)),
+		_char_width(char_width),
+		_breaker(brmode)
+	{
+	}
+
+	inline iterator begin() { iterator iter { this }; ++iter; return iter; }
+	inline std::default_sentinel_t end() const { return {}; }
+
+	// the next line, or false if there are no more
+	bool next(Line &line);
+
+private:
+	inline std::size_t char_width(char32_t codepoint) const { return static_cast<std::size_t>(std::max(0, _char_width(codepoint))); }
+	// end & width of the longest part from 'start' that fits in 'limit' cells, without spaces at the end
+	std::pair<std::size_t, std::size_t> fit(std::size_t start, std::size_t limit) const;
+
+private:
+	std::string_view _s;
+	std::size_t _limit;
+	CharWidth _char_width;
+	LineBreaker _breaker;
+	std::size_t _offset { 0 };
+	bool _mid_word { false };  // the previous line was cut; '_breaker' continues from there
+	bool _done { false };
+};
+
+template<typename CharWidth=CellWidth>
+inline Lines<CharWidth> lines(std::string_view s, std::size_t limit, BreakMode brmode=WesternBreaks, CharWidth char_width={})
+{
+	return Lines<CharWidth>(s, limit, brmode, char_width);
+}
+
+template<typename CharWidth>
+std::pair<std::size_t, std::size_t> Lines<CharWidth>::fit(std::size_t start, std::size_t limit) const
+{
+	std::size_t end { start };
+	std::size_t end_width { 0 };
+	std::size_t width { 0 };
+
+	for(auto offset = start; offset < _s.size(); )
+	{
+		const auto [cp, seq] = utf8::read_valid(_s.substr(offset));
+		const auto w = char_width(cp);
+		if(width + w > limit)
+			break;
+		width += w;
+		offset += seq.size();
+		if(not utf8::is_brk_space(cp))
+		{
+			end = offset;
+			end_width = width;
+		}
+	}
+
+	return { end, end_width };
+}
+
+template<typename CharWidth>
+bool Lines<CharWidth>::next(Line &line)
+{
+	if(_done)
+		return false;
+
+	// a line starts where a break is allowed, which is the same as the start of a text (as far as the rules go)
+	if(not _mid_word)
+		_breaker.reset();
+	_mid_word = false;
+
+	// spaces at the start of a (wrapped) line are skipped  (but some of them still affect the breaks after them)
+	while(_offset < _s.size())
+	{
+		const auto [cp, seq] = utf8::read_valid(_s.substr(_offset));
+		if(not utf8::is_brk_space(cp))
+			break;
+		_breaker.next(cp);
+		_offset += seq.size();
+	}
+	const auto line_breaker = _breaker;
+
+	line = { _offset, _offset, 0, false };
+
+	// where to end the line if the next character doesn't fit
+	std::size_t break_end { _offset };
+	std::size_t break_width { 0 };
+	std::size_t break_next { _offset };
+
+	// end of the last non-space character
+	std::size_t content_end { _offset };
+	std::size_t content_width { 0 };
+	std::size_t width { 0 };
+
+	auto offset = _offset;
+	while(offset < _s.size())
+	{
+		const auto [cp, seq] = utf8::read_valid(_s.substr(offset));
+
+		if(is_line_end(cp))
+		{
+			line.end = content_end;
+			line.width = content_width;
+			_offset = offset + seq.size();
+			if(cp == '\r' and _offset < _s.size() and _s[_offset] == '\n')
+				++_offset;
+			return true;
+		}
+
+		if(_breaker.next(cp) == LineBreaker::Allowed and content_end > line.start)
+		{
+			break_end = content_end;
+			break_width = content_width;
+			break_next = offset;
+		}
+
+		const auto cw = char_width(cp);
+
+		if(utf8::is_brk_space(cp))
+		{
+			width += cw;
+			offset += seq.size();
+			continue;
+		}
+
+		if(width + cw > _limit and content_end > line.start)  // (a character too wide for any line gets one anyway)
+		{
+			if(break_end > line.start)
+			{
+				line.end = break_end;
+				line.width = break_width;
+				_offset = break_next;
+				return true;
+			}
+
+			// no place to break; cut the word
+			line.hyphen = _limit >= 3;
+			if(line.hyphen and content_width > _limit - 1)  // make room for the hyphen
+				std::tie(content_end, content_width) = fit(line.start, _limit - 1);
+			if(content_end == line.start)  // only the hyphen fits; take a character anyway
+			{
+				const auto [c, c_seq] = utf8::read_valid(_s.substr(line.start));
+				content_end = line.start + c_seq.size();
+				content_width = char_width(c);
+				line.hyphen = false;
+			}
+
+			line.end = content_end;
+			line.width = content_width + (line.hyphen? 1: 0);
+			_offset = content_end;
+
+			// the rest of the word continues on the next line, as if it wasn't cut
+			_breaker = line_breaker;
+			for(auto o = line.start; o < content_end; )
+			{
+				const auto [c, c_seq] = utf8::read_valid(_s.substr(o));
+				_breaker.next(c);
+				o += c_seq.size();
+			}
+			_mid_word = true;
+
+			return true;
+		}
+
+		width += cw;
+		offset += seq.size();
+		content_end = offset;
+		content_width = width;
+	}
+
+	line.end = content_end;
+	line.width = content_width;
+	_offset = _s.size();
+	_done = true;
+	return true;
+}
+
+// wrap 's' into lines (see Lines)
 std::vector<std::string> wrap(std::string_view s, std::size_t limit, termic::text::BreakMode brmode=WesternBreaks);
 
+// remembers where paragraphs can be broken, and the widths of their words,
+//   so they can be wrapped to a different width without decoding them again (e.g. while a window is resized).
+//   the least recently used paragraphs are forgotten when it uses more than 'max_bytes'.
+struct LayoutCache
+{
+	explicit LayoutCache(std::size_t max_bytes=4 << 20);
+
+	// as lines(), but all at once; valid until the next call
+	std::span<const Line> wrap(std::string_view s, std::size_t limit, BreakMode brmode=WesternBreaks);
+
+	void clear();
+	// approximately
+	inline std::size_t memory_used() const { return _bytes; }
+
+private:
+	// a word (or a part of one, up to and including a hyphen), followed by a break opportunity
+	struct Segment
+	{
+		std::uint32_t start;
+		std::uint32_t end;
+		std::uint32_t width;
+		std::uint32_t space_after;  // width of the spaces following it
+		bool newline_after;
+	};
+
+	struct Paragraph
+	{
+		std::string text;
+		BreakMode brmode;
+		std::vector<Segment> segments;
+
+		// the lines for the most recent 'limit'
+		std::size_t limit { 0 };
+		std::vector<Line> lines;
+
+		std::size_t bytes() const;
+	};
+
+	static void segment(Paragraph &p);
+	static void break_lines(Paragraph &p, std::size_t limit);
+	void evict();
+
+private:
+	std::size_t _max_bytes;
+	std::size_t _bytes { 0 };
+
+	std::list<Paragraph> _paragraphs;  // most recently used first
+	std::unordered_map<std::string_view, std::list<Paragraph>::iterator> _index;  // keys are the paragraphs' texts
+
+	std::vector<Line> _uncached;  // for paragraphs too large to cache
+};
+
+// remembers the widths of recently measured strings, e.g. labels that are printed (aligned) every frame.
+//   one entry per hash of the content; plain ASCII is quicker to measure than to look up, and long strings aren't kept.
+struct WidthCache
+{
+	static constexpr std::size_t num_entries { 256 };
+	static constexpr std::size_t max_length { 256 };
+
+	// as width()
+	std::size_t width(std::string_view s);
+
+	void clear();
+	// number of widths taken from the cache
+	inline std::size_t hits() const { return _hits; }
+
+private:
+
+	struct Entry
+	{
+		std::size_t hash { 0 };
+		std::string text;
+		std::size_t width { 0 };
+	};
+	std::vector<Entry> _entries;  // allocated when first used
+	std::size_t _hits { 0 };
+};
+
 struct Word
 {
 	std::size_t start { 0 };
@@ -29,15 +366,72 @@ struct Word
 	bool hyphenated { false };
 };
 
+// the pieces of 's' between line break opportunities (see LineBreaker), without surrounding spaces.
+//   offsets are into 's' itself, i.e. leading spaces are counted
 std::vector<Word> words(std::string_view s, std::function<int (char32_t)> char_width, termic::text::BreakMode brmode=WesternBreaks);
 
-// TODO: should use something established instead, e.g. https://github.com/DuffsDevice/tiny-utf8
-//   these functions are very slow, they always perform iteration from the beginning
+// positions are in codepoints.  the utf8::string versions use its index;
+//   the utf8::string_view versions iterate from the beginning every time
 
 utf8::string &insert(utf8::string &s, utf8::string_view insert, std::size_t at);
 utf8::string &erase(utf8::string &s, std::size_t start, std::size_t len);
 std::size_t size(utf8::string_view s);
 utf8::string_view substr(utf8::string_view s, std::size_t start, std::size_t len=utf8::string::npos);
+utf8::string_view substr(const utf8::string &s, std::size_t start, std::size_t len=utf8::string::npos);
+
+
+// a (large) editable text, stored as a balanced tree of chunks (a rope).
+//   edits are O(log n) and copying a document is O(1): the copies share all unchanged chunks,
+//   so a copy works as a snapshot (e.g. for undo, or for drawing while editing continues).
+//   positions are byte offsets; lines are separated by '\n' (which is not part of a line).
+struct Document
+{
+	Document() = default;
+	explicit Document(std::string_view s);
+
+	// size in bytes
+	inline std::size_t size() const { return bytes(_root); }
+	inline bool empty() const { return not _root; }
+	// number of lines; always at least one
+	inline std::size_t lines() const { return newlines(_root) + 1; }
+
+	void insert(std::size_t offset, std::string_view s);
+	void erase(std::size_t offset, std::size_t len);
+
+	// byte offset of the start of 'line'  (size() if there are not that many lines)
+	std::size_t line_start(std::size_t line) const;
+	// the line which contains 'offset'
+	std::size_t line_of(std::size_t offset) const;
+
+	std::string substr(std::size_t offset, std::size_t len=std::string::npos) const;
+	std::string line(std::size_t line) const;
+	std::string str() const;
+
+	// calls 'f' for each contiguous piece of [offset, offset + len), in order
+	void chunks(std::size_t offset, std::size_t len, const std::function<void (std::string_view)> &f) const;
+
+	// calls 'f(line, text, hyphen)' for each visual line of lines wrapped to 'limit' cells (see Lines),
+	//   starting at the logical line 'first_line', until 'f' returns false.
+	//   only one line at a time is looked at; lines split across chunks are the only ones copied.
+	void visual_lines(std::size_t first_line, std::size_t limit, const std::function<bool (std::size_t, std::string_view, bool)> &f, BreakMode brmode=WesternBreaks) const;
+
+private:
+	struct Node;
+	using NodePtr = std::shared_ptr<const Node>;
+
+	static std::size_t bytes(const NodePtr &node);
+	static std::size_t newlines(const NodePtr &node);
+
+	static NodePtr make(std::string_view chunk, std::uint32_t priority, NodePtr left, NodePtr right);
+	static NodePtr build(std::string_view s);
+	static std::pair<NodePtr, NodePtr> split(const NodePtr &node, std::size_t offset);
+	static NodePtr merge(const NodePtr &a, const NodePtr &b);
+	static NodePtr insert_into(const NodePtr &node, std::size_t offset, std::string_view s);
+	static void chunks(const Node *node, std::size_t offset, std::size_t end, const std::function<void (std::string_view)> &f);
+
+private:
+	NodePtr _root;
+};
 
 
 } // MS: text
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "cell.h"
+#include "size.h"
+
+
+namespace termic
+{
+
+struct ScreenBuffer;
+
+// a sparse cell buffer, intended for virtual canvases much larger than the screen.
+//   storage is allocated in tiles, on the first write to a tile;
+//   unwritten tiles all read from a single shared blank tile.
+struct TiledBuffer
+{
+	static constexpr std::size_t tile_width { 64 };
+	static constexpr std::size_t tile_height { 16 };
+
+	TiledBuffer(Size size={ 0, 0 });
+
+	// discards all content
+	void set_size(Size size);
+	inline Size size() const { return { _width, _height }; };
+
+	// releases all tiles
+	void clear();
+
+	inline const Cell &cell(Pos pos) const
+	{
+		return tile(pos)[tile_offset(pos)];
+	}
+	void set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk=look::Default);
+
+	// copy the cells in 'src_rect' to 'dst', with the top left corner at 'dst_pos' (clipped to both buffers)
+	void blit(ScreenBuffer &dst, Rectangle src_rect, Pos dst_pos={ 0, 0 }) const;
+
+	// number of tiles with storage allocated
+	std::size_t allocated_tiles() const;
+
+private:
+	using Tile = std::array<Cell, tile_width*tile_height>;
+
+	static const Tile &blank_tile();
+
+	// allocates the tile, if necessary
+	Cell &writable_cell(Pos pos);
+
+	inline std::size_t tile_index(Pos pos) const
+	{
+		return (pos.y / tile_height)*_tiles_x + pos.x / tile_width;
+	}
+	inline static std::size_t tile_offset(Pos pos)
+	{
+		return (pos.y % tile_height)*tile_width + pos.x % tile_width;
+	}
+	inline const Tile &tile(Pos pos) const
+	{
+		const auto &t = _tiles[tile_index(pos)];
+		return t? *t: blank_tile();
+	}
+
+private:
+	std::vector<std::unique_ptr<Tile>> _tiles;
+
+	std::size_t _width { 0 };
+	std::size_t _height { 0 };
+	std::size_t _tiles_x { 0 };
+};
+
+} // NS: termic
@@ -7,6 +7,7 @@
 #include <functional>
 #include <limits>
 #include <cstdint>
+#include <cstring>
 
 
 namespace termic
@@ -15,18 +16,70 @@ namespace termic
 namespace utf8
 {
 
-// Q: is it overkill to implement a custom utf8 string?
-//   probably modelled as a std::vector<Iterator::Character>
-// A: definitely! ;)
-// a better way is something like https://github.com/DuffsDevice/tiny-utf8
+using string_view = std::string_view; // TODO: use instead of std::string_view
+
+// a UTF-8 string with positions counted in codepoints.
+//   keeps a sparse index of (codepoint, byte offset) checkpoints, about every 'checkpoint_interval' codepoints,
+//   so finding a position is a binary search and a short scan, and edits only adjust the index after them.
+struct string
+{
+	static constexpr std::size_t npos { std::string::npos };
+	static constexpr std::size_t checkpoint_interval { 64 };
 
+	string() = default;
+	explicit string(std::string_view s);
+	explicit inline string(const char *s) : string(std::string_view(s)) {}
 
-using string = std::string;           // TODO: use instead of std::string
-using string_view = std::string_view; // TODO: use instead of std::string_view
+	// number of codepoints
+	inline std::size_t size() const { return _size; }
+	inline bool empty() const { return _bytes.empty(); }
+	inline const std::string &bytes() const { return _bytes; }
+	inline operator std::string_view() const { return _bytes; }
+
+	inline bool operator == (std::string_view other) const { return _bytes == other; }
+
+	// byte offset of the codepoint at 'at' (the byte size if past the end)
+	std::size_t byte_offset(std::size_t at) const;
+
+	string &insert(std::size_t at, std::string_view s);
+	string &erase(std::size_t start, std::size_t len=npos);
+	std::string_view substr(std::size_t start, std::size_t len=npos) const;
+
+private:
+	struct Checkpoint
+	{
+		std::size_t index;        // codepoint
+		std::size_t byte_offset;
+	};
+	// add checkpoints between codepoint 'index' at 'byte_offset' and 'end_byte'  (returns the number of codepoints scanned)
+	std::size_t index_range(std::size_t index, std::size_t byte_offset, std::size_t end_byte, std::vector<Checkpoint> &out) const;
+	// the last checkpoint at or before codepoint 'at'
+	std::vector<Checkpoint>::const_iterator checkpoint_before(std::size_t at) const;
+	void rebalance(std::size_t at);
+
+private:
+	std::string _bytes;
+	std::vector<Checkpoint> _checkpoints { Checkpoint{ 0, 0 } };  // sorted; the first is always { 0, 0 }
+	std::size_t _size { 0 };
+};
 
 // extract a single codepoint from the input data, returning its codepoint and the byte sequence
+//   doesn't validate; an incomplete sequence eats nothing (i.e. wait for more input)
 std::pair<char32_t, std::string_view> read_one(std::string_view s, std::size_t *eaten);
 
+// substituted for invalid input
+inline constexpr char32_t replacement { 0xfffd };
+inline constexpr std::string_view replacement_sequence { "\xef\xbf\xbd" };
+
+// as read_one(), but invalid sequences (bad or missing continuation bytes, overlongs, surrogates, > U+10FFFF)
+//   become 'replacement'.  always eats at least one byte (unless 's' is empty):
+//   the longest part that might have started a valid sequence, as recommended by Unicode (ch. 3.9).
+std::pair<char32_t, std::string_view> read_valid(std::string_view s);
+
+// all codepoints of 's', validated as read_valid()
+std::u32string decode(std::string_view s);
+bool is_valid(std::string_view s);
+
 
 struct Iterator
 {
@@ -46,7 +99,8 @@ struct Iterator
 
 	friend Iterator end(std::string_view s);
 
-	explicit Iterator(std::string_view s);
+	// 'validate': see read_valid(); otherwise, the bytes are trusted to be valid UTF-8
+	explicit Iterator(std::string_view s, bool validate=true);
 
 	inline Character operator * () const { return _current; }
 	inline const Character *operator -> () const { return &_current; }
@@ -65,11 +119,12 @@ private:
 	std::string_view _s;
 	std::size_t _head_offset { 0 };
 	Character _current;
+	bool _validate;
 };
 
-inline Iterator begin(std::string_view s)
+inline Iterator begin(std::string_view s, bool validate=true)
 {
-	return Iterator(s);
+	return Iterator(s, validate);
 }
 
 inline Iterator end(std::string_view s)
@@ -136,6 +191,111 @@ inline bool is_brk_space(char32_t codepoint)
 	return false;
 }
 
+// number of printable ASCII characters (0x20 - 0x7e) at the start of 's'; they're one byte & one cell each.
+//   looks at 8 bytes at a time
+inline std::size_t ascii_run(std::string_view s)
+{
+	constexpr std::uint64_t ones { 0x0101010101010101 };
+	constexpr std::uint64_t high_bits { 0x8080808080808080 };
+
+	auto printable = [](char ch) { return static_cast<unsigned char>(ch) - 0x20u < 0x5fu; };
+
+	std::size_t offset { 0 };
+	for(; offset + 8 <= s.size(); offset += 8)
+	{
+		std::uint64_t w;
+		std::memcpy(&w, s.data() + offset, sizeof(w));
+
+		// high bit set in bytes that are >= 0x80, < 0x20 or 0x7f
+		//   (borrows can only flag bytes after one that's already flagged)
+		if((w | (w - ones*0x20) | ((w ^ ones*0x7f) - ones)) & high_bits)
+			break;
+	}
+
+	while(offset < s.size() and printable(s[offset]))
+		++offset;
+
+	return offset;
+}
+
+namespace tables
+{
+
+// generated from the Unicode database, by src/gen-unicode-tables.pl
+extern const std::uint8_t width_index[0x110000 / 256];
+extern const std::int8_t width_blocks[][256];
+extern const std::uint8_t line_break_index[0x110000 / 256];
+extern const std::uint8_t line_break_blocks[][256];
+extern const std::uint8_t grapheme_break_index[0x110000 / 256];
+extern const std::uint8_t grapheme_break_blocks[][256];
+
+} // NS: tables
+
+// display width of 'codepoint', in cells (as wcwidth()): 0, 1 or 2, or -1 for control characters.
+//   a lookup in two-level tables; ASCII doesn't need them
+inline int width(char32_t codepoint)
+{
+	if(codepoint < 0x7f)
+		return static_cast<int>(codepoint >= 0x20) - static_cast<int>(codepoint - 1 < 0x1f);
+	if(codepoint >= 0x110000)
+		return 1;
+
+	return tables::width_blocks[tables::width_index[codepoint >> 8]][codepoint & 0xff];
+}
+
+// line breaking classes, https://unicode.org/reports/tr14
+//   the order must match src/gen-unicode-tables.pl; the ones after CB are never in text::LineBreaker's pair table
+enum class LineBreak : std::uint8_t
+{
+	OP, CL, CP, QU, GL, NS, EX, SY, IS, PR, PO, NU, AL, HL, ID, IN, HY, BA, BB, B2, ZW, CM, WJ, H2, H3, JL, JV, JT, RI, EB, EM, ZWJ, CB,
+	BK, CR, LF, NL, SP, AI, CJ, SA,
+};
+
+// line breaking class of 'codepoint'; unassigned & surrogates are AL, SA marks are CM
+inline LineBreak line_break(char32_t codepoint)
+{
+	if(codepoint >= 0x110000)
+		return LineBreak::AL;
+
+	return static_cast<LineBreak>(tables::line_break_blocks[tables::line_break_index[codepoint >> 8]][codepoint & 0xff]);
+}
+
+// grapheme cluster break properties, https://unicode.org/reports/tr29
+//   Extended_Pictographic is included (it's otherwise 'Other'); the order must match src/gen-unicode-tables.pl
+enum class GraphemeBreak : std::uint8_t
+{
+	Other, CR, LF, Control, Extend, ZWJ, RegionalIndicator, Prepend, SpacingMark, L, V, T, LV, LVT, ExtendedPictographic,
+};
+
+inline GraphemeBreak grapheme_break(char32_t codepoint)
+{
+	if(codepoint >= 0x110000)
+		return GraphemeBreak::Other;
+
+	return static_cast<GraphemeBreak>(tables::grapheme_break_blocks[tables::grapheme_break_index[codepoint >> 8]][codepoint & 0xff]);
+}
+
+// a grapheme cluster; what's perceived as a single character, e.g. a letter with accents, a flag or an emoji sequence
+struct Cluster
+{
+	char32_t codepoint { 0 };     // the first one
+	std::string_view sequence {};
+	int width { 0 };              // in cells, as width(): 0, 1 or 2, or -1 for control characters
+};
+
+// read the first grapheme cluster of 's' (extended, without the Indic conjunct rule).
+//   invalid input is read as read_valid() does, and is a cluster of its own (see is_invalid()).
+//   the width is that of the characters that take up space of their own; emoji made wide by U+FE0F count as 2,
+//   and the characters joined by ZWJ as nothing.
+//   a character below U+0300 that isn't followed by a combining character doesn't need any tables.
+Cluster read_cluster(std::string_view s);
+
+// whether 'c' is invalid input, i.e. a replacement for what was actually there
+inline bool is_invalid(const Cluster &c)
+{
+	return c.codepoint == replacement and not c.sequence.starts_with(replacement_sequence);
+}
+
 } // NS: utf8
 
 } // NS: termic
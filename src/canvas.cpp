@@ -5,6 +5,11 @@
 
 #include <fmt/core.h>
 
+#include <array>
+#include <bit>
+#include <cstring>
+#include <vector>
+
 namespace termic
 {
 
@@ -30,61 +35,81 @@ void Canvas::fill(const color::Sampler *s, float sampler_angle)
 
 void Canvas::fill(Rectangle rect, Color c)
 {
-	color::Constant cc(c);
-	fill(rect, &cc);
+	if(_screen._recording)
+	{
+		_screen._draw_list.fill(rect, c);
+		_screen.invalidate();
+		return;
+	}
+
+	_screen._back_buffer.set_cells(rect, Cell::NoChange, 1, look::bg(c));
+	_screen.invalidate();
 }
 
 void Canvas::fill(Rectangle rect, const color::Sampler *s, float sampler_angle)
 {
-	rect.size.width = std::max(1ul, rect.size.width);
-	rect.size.height = std::max(1ul, rect.size.height);
+	fill(rect, s, sampler_angle, false);
+}
 
-	// TODO: _scr.iterator(rect) ?
+void Canvas::fill(Rectangle rect, const color::Sampler *s, float sampler_angle, parallel_policy)
+{
+	fill(rect, s, sampler_angle, true);
+}
 
-	const auto size = _screen.size();
+void Canvas::fill(Rectangle rect, const color::Sampler *s, float sampler_angle, bool parallel)
+{
+	if(const auto *constant = dynamic_cast<const color::Constant *>(s); constant)
+		return fill(rect, constant->color());
 
-	for(auto y = rect.top_left.y; y <= rect.top_left.y + rect.size.height - 1 and y < size.height; y++)
+	if(_screen._recording)
 	{
-		for(auto x = rect.top_left.x; x <= rect.top_left.x + rect.size.width - 1 and x < size.width; x++)
-		{
-			const float u = static_cast<float>(x - rect.top_left.x + 1) / float(rect.size.width);
-			const float v = static_cast<float>(y - rect.top_left.y + 1) / float(rect.size.height);
-
-			_screen.set_cell({ x, y }, Cell::NoChange, 1, look::bg(s->sample({ u, v }, sampler_angle)));
-		}
+		_screen._draw_list.fill(rect, s, sampler_angle, parallel);
+		_screen.invalidate();
+		return;
 	}
-	_screen.invalidate();
-}
 
-void Canvas::filter(std::function<void(Look &, UV)> f)
-{
-	filter(_screen.rect(), f);
-}
+	const auto area = clipped(rect);
 
-void Canvas::filter(Rectangle rect, std::function<void (Look &, UV)> f)
-{
-	rect.size.width = std::max(1ul, rect.size.width);
-	rect.size.height = std::max(1ul, rect.size.height);
+	// u & v are in (0, 1], relative to the whole (unclipped) rectangle
+	const auto du = 1.f / float(rect.size.width);
+	const auto dv = 1.f / float(rect.size.height);
+	const auto u0 = float(area.top_left.x - rect.top_left.x + 1) * du;
+	const auto row0 = area.top_left.y - rect.top_left.y;
 
-	// TODO: _scr.iterator(rect) ?
+	auto &buffer = _screen._back_buffer;
 
-	const auto size = _screen.size();
+	for_bands(area, parallel, [&](std::size_t first, std::size_t last) {
+		std::vector<Color> colors(area.size.width);
 
-	for(auto y = rect.top_left.y; y <= rect.top_left.y + rect.size.height - 1 and y < size.height; y++)
-	{
-		for(auto x = rect.top_left.x; x <= rect.top_left.x + rect.size.width - 1 and x < size.width; x++)
+		for(auto row = first; row < last; ++row)
 		{
-			const float u = static_cast<float>(x - rect.top_left.x + 1) / float(rect.size.width);
-			const float v = static_cast<float>(y - rect.top_left.y + 1) / float(rect.size.height);
-
-			auto &cell = _screen.cell({ x, y });
-			Look lk { cell.look };
+			const auto v = std::min(1.f, float(row0 + row + 1) * dv);
 
-			f(lk, UV{ u, v });
+			s->sample_row(v, u0, du, colors.size(), colors.data(), sampler_angle);
 
-			cell.look = lk;
+			auto cell = buffer.span({ area.top_left.x, area.top_left.y + row }, area.size.width).begin();
+			for(const auto c: colors)
+			{
+				cell->width = 1;
+				if(c != color::NoChange)
+					cell->look.bg = c;
+				++cell;
+			}
 		}
-	}
+	});
+}
+
+void Canvas::fill(Rectangle rect, color::Rgba c)
+{
+	composite(rect, {}, c);
+}
+
+void Canvas::composite(Rectangle rect, color::Rgba fg, color::Rgba bg)
+{
+	if(_screen._recording)
+		_screen._draw_list.composite(rect, fg, bg);
+	else
+		_screen._back_buffer.composite(rect, fg, bg);
 	_screen.invalidate();
 }
 
@@ -105,16 +130,206 @@ void Canvas::fade(Rectangle rect, float blend)
 
 void Canvas::fade(Rectangle rect, Color fg, Color bg, float blend)
 {
-	if(blend == 0 or (fg == color::NoChange and bg == color::NoChange))
+	fade(rect, fg, bg, blend, false);
+}
+
+void Canvas::fade(Rectangle rect, Color fg, Color bg, float blend, parallel_policy)
+{
+	fade(rect, fg, bg, blend, true);
+}
+
+void Canvas::fade(Rectangle rect, Color fg, Color bg, float blend, bool parallel)
+{
+	if(_screen._recording)
+	{
+		_screen._draw_list.fade(rect, fg, bg, blend, parallel);
+		_screen.invalidate();
 		return;
+	}
+
+	const auto area = clipped(rect);
 
-	filter(rect, [=](Look &lk, UV) {
-		if(fg != color::NoChange)
-			lk.fg = color::lerp(lk.fg, fg, blend);
-		if(bg != color::NoChange)
-			lk.bg = color::lerp(lk.bg, bg, blend);
+	for_bands(area, parallel, [&](std::size_t first, std::size_t last) {
+		_screen._back_buffer.fade({ { area.top_left.x, area.top_left.y + first }, { area.size.width, last - first } }, fg, bg, blend);
 	});
 }
 
+// two independent hashes of the pixels of an image
+static std::array<std::uint64_t, 2> image_hash(const std::uint8_t *rgb, std::size_t width, std::size_t height, std::size_t stride)
+{
+	std::uint64_t h1 { 0xcbf29ce484222325ull };
+	std::uint64_t h2 { 0x9e3779b97f4a7c15ull };
+
+	const auto mix = [&h1, &h2](std::uint64_t word) {
+		h1 = (h1 ^ word)*0x100000001b3ull;
+		h1 ^= h1 >> 29;
+		h2 = std::rotl(h2 + word*0xff51afd7ed558ccdull, 31)*0xc4ceb9fe1a85ec53ull;
+	};
+
+	const auto row_bytes = width*3;
+	for(std::size_t y = 0; y < height; ++y)
+	{
+		const auto *row = rgb + y*stride;
+
+		std::size_t idx = 0;
+		for(; idx + 8 <= row_bytes; idx += 8)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, row + idx, sizeof(word));
+			mix(word);
+		}
+		for(; idx < row_bytes; ++idx)
+			mix(row[idx]);
+	}
+
+	return { h1, h2 };
+}
+
+// box filter: each output pixel is the average of the input pixels it covers  (at least one)
+static std::vector<Color> scale_image(const std::uint8_t *rgb, std::size_t width, std::size_t height, std::size_t stride, Size scaled)
+{
+	std::vector<Color> pixels(scaled.area());
+
+	// the input columns of each output column
+	std::vector<std::size_t> x_first(scaled.width);
+	std::vector<std::size_t> x_last(scaled.width);
+	for(std::size_t x = 0; x < scaled.width; ++x)
+	{
+		x_first[x] = x*width / scaled.width;
+		x_last[x] = std::max(x_first[x] + 1, (x + 1)*width / scaled.width);
+	}
+
+	// per channel sums of the output row being computed
+	std::vector<std::uint32_t> r(scaled.width), g(scaled.width), b(scaled.width);
+
+	for(std::size_t y = 0; y < scaled.height; ++y)
+	{
+		const auto y_first = y*height / scaled.height;
+		const auto y_last = std::max(y_first + 1, (y + 1)*height / scaled.height);
+
+		std::fill(r.begin(), r.end(), 0);
+		std::fill(g.begin(), g.end(), 0);
+		std::fill(b.begin(), b.end(), 0);
+
+		for(auto sy = y_first; sy < y_last; ++sy)
+		{
+			const auto *row = rgb + sy*stride;
+
+			for(std::size_t x = 0; x < scaled.width; ++x)
+			{
+				std::uint32_t sr { 0 }, sg { 0 }, sb { 0 };
+				for(auto sx = x_first[x]; sx < x_last[x]; ++sx)
+				{
+					sr += row[sx*3];
+					sg += row[sx*3 + 1];
+					sb += row[sx*3 + 2];
+				}
+				r[x] += sr;
+				g[x] += sg;
+				b[x] += sb;
+			}
+		}
+
+		auto *out = &pixels[y*scaled.width];
+		for(std::size_t x = 0; x < scaled.width; ++x)
+		{
+			const auto n = std::uint32_t((x_last[x] - x_first[x])*(y_last - y_first));
+			out[x] = color::rgb(std::uint8_t(r[x] / n), std::uint8_t(g[x] / n), std::uint8_t(b[x] / n));
+		}
+	}
+
+	return pixels;
+}
+
+std::size_t Canvas::cached_images() const
+{
+	return _screen._image_cache.size();
+}
+
+void Canvas::blit_image(Rectangle rect, const std::uint8_t *rgb, std::size_t width, std::size_t height, std::size_t stride, ImageMode mode)
+{
+	if(not rgb or width == 0 or height == 0)
+		return;
+
+	if(stride == 0)
+		stride = width*3;
+
+	const auto area = clipped(rect);
+	if(area.area() == 0)
+		return;
+
+	// the image is scaled to the whole rectangle, even if only a part of it is visible
+	const Size scaled { rect.size.width, rect.size.height*(mode == HalfBlocks? 2: 1) };
+
+	auto &cache = _screen._image_cache;
+	const auto hash = image_hash(rgb, width, height, stride);
+	const Screen::ImageKey key { width, height, scaled, { hash[0], hash[1] } };
+
+	auto found = std::find_if(cache.begin(), cache.end(), [&key](const auto &entry) {
+		const auto &k = entry.key;
+		return k.width == key.width and k.height == key.height
+			and k.scaled.width == key.scaled.width and k.scaled.height == key.scaled.height
+			and k.hash[0] == key.hash[0] and k.hash[1] == key.hash[1];
+	});
+	if(found == cache.end())
+	{
+		static constexpr std::size_t max_cached { 8 };
+		if(cache.size() == max_cached)
+			cache.erase(cache.begin());
+
+		cache.push_back({ key, scale_image(rgb, width, height, stride, scaled) });
+	}
+	else
+		std::rotate(found, found + 1, cache.end());
+
+	const auto &pixels = cache.back().pixels;
+
+	_screen.play();  // direct drawing; anything recorded comes first
+
+	auto &buffer = _screen._back_buffer;
+	const auto dx = area.top_left.x - rect.top_left.x;
+	const auto dy = area.top_left.y - rect.top_left.y;
+
+	for(std::size_t row = 0; row < area.size.height; ++row)
+	{
+		const Pos row_pos { area.top_left.x, area.top_left.y + row };
+		auto cells = buffer.span(row_pos, area.size.width);
+
+		if(mode == HalfBlocks)
+		{
+			const auto *top = &pixels[(dy + row)*2*scaled.width + dx];
+			const auto *bottom = top + scaled.width;
+
+			for(std::size_t x = 0; x < cells.size(); ++x)
+			{
+				static constexpr std::string_view half_block { "▀" };
+				std::copy_n(half_block.data(), half_block.size() + 1, cells[x].ch);
+				cells[x].width = 1;
+				cells[x].look = { top[x], bottom[x], style::Default };
+			}
+			buffer.fix_wide_edges(row_pos, cells.size());
+		}
+		else
+		{
+			const auto *src = &pixels[(dy + row)*scaled.width + dx];
+
+			for(std::size_t x = 0; x < cells.size(); ++x)
+			{
+				cells[x].width = 1;
+				cells[x].look.bg = src[x];
+			}
+		}
+	}
+	_screen.invalidate();
+}
+
+Rectangle Canvas::clipped(Rectangle &rect) const
+{
+	rect.size.width = std::max(1ul, rect.size.width);
+	rect.size.height = std::max(1ul, rect.size.height);
+
+	return rect.intersected({ { 0, 0 }, _screen.size() });
+}
+
 
 } // NS: termic
@@ -0,0 +1,368 @@
+#include <termic/draw-list.h>
+
+#include <termic/parallel.h>
+#include <termic/screen-buffer.h>
+
+#include <algorithm>
+
+namespace termic
+{
+
+// an empty rectangle counts as a single cell, as elsewhere
+static Rectangle normalized(Rectangle rect)
+{
+	rect.size.width = std::max(1ul, rect.size.width);
+	rect.size.height = std::max(1ul, rect.size.height);
+	return rect;
+}
+
+// the look fields that a print (or clear) with 'lk' sets
+static std::uint8_t look_fields(Look lk, std::uint8_t fg, std::uint8_t bg, std::uint8_t style)
+{
+	return std::uint8_t(
+		(lk.fg == color::NoChange? 0: fg) |
+		(lk.bg == color::NoChange? 0: bg) |
+		(lk.style == style::NoChange? 0: style)
+	);
+}
+
+void DrawList::clear(Rectangle rect, Color bg, Color fg)
+{
+	_commands.emplace_back(Clear{ normalized(rect), bg, fg });
+}
+
+void DrawList::fill(Rectangle rect, Color c)
+{
+	_commands.emplace_back(Fill{ normalized(rect), c });
+}
+
+void DrawList::fill(Rectangle rect, const color::Sampler *s, float angle, bool parallel)
+{
+	_commands.emplace_back(Sample{ normalized(rect), s, angle, parallel });
+}
+
+void DrawList::filter(Rectangle rect, RowFilter f, bool parallel)
+{
+	_commands.emplace_back(Filter{ normalized(rect), std::move(f), parallel });
+}
+
+void DrawList::fade(Rectangle rect, Color fg, Color bg, float blend, bool parallel)
+{
+	if(color::mix_weight(blend) == 0 or (fg == color::NoChange and bg == color::NoChange))
+		return;
+
+	_commands.emplace_back(Fade{ normalized(rect), fg, bg, blend, parallel });
+}
+
+void DrawList::composite(Rectangle rect, color::Rgba fg, color::Rgba bg)
+{
+	if(fg.a == 0 and bg.a == 0)
+		return;
+
+	_commands.emplace_back(Composite{ normalized(rect), fg, bg });
+}
+
+void DrawList::print(Pos pos, std::string_view s, Look lk)
+{
+	_commands.emplace_back(Print{ pos, std::string(s), lk });
+}
+
+void DrawList::discard()
+{
+	_commands.clear();
+}
+
+// fields that are set regardless of their previous value  (a later command that covers a field makes earlier writes to it pointless)
+std::uint8_t DrawList::covers(const Command &cmd)
+{
+	if(const auto *c = std::get_if<Clear>(&cmd); c)
+		return std::uint8_t(Content | Style | look_fields({ c->fg, style::Default, c->bg }, Fg, Bg, 0));
+	if(const auto *f = std::get_if<Fill>(&cmd); f)
+		return f->c == color::NoChange? 0: Bg;
+	if(const auto *p = std::get_if<Print>(&cmd); p)
+		return std::uint8_t(Content | look_fields(p->lk, Fg, Bg, Style));
+
+	// samplers may leave cells unchanged; filters, fades & composites depend on what's there
+	return 0;
+}
+
+// fields that are (possibly) changed
+std::uint8_t DrawList::writes(const Command &cmd)
+{
+	if(std::holds_alternative<Fill>(cmd) or std::holds_alternative<Sample>(cmd))
+		return Content | Bg;  // sets width
+	if(std::holds_alternative<Filter>(cmd))
+		return Fg | Bg | Style;
+	if(const auto *f = std::get_if<Fade>(&cmd); f)
+		return std::uint8_t((f->fg == color::NoChange? 0: Fg) | (f->bg == color::NoChange? 0: Bg));
+	if(const auto *c = std::get_if<Composite>(&cmd); c)
+		return std::uint8_t((c->fg.a == 0? 0: Fg) | (c->bg.a == 0? 0: Bg));
+
+	return covers(cmd);
+}
+
+// whether the previous values of the cells are used  (a filter may look at any field, so that's all of them)
+bool DrawList::reads(const Command &cmd)
+{
+	return std::holds_alternative<Filter>(cmd) or std::holds_alternative<Fade>(cmd) or std::holds_alternative<Composite>(cmd);
+}
+
+inline void DrawList::cover(std::size_t index, std::uint8_t fields, std::size_t cell)
+{
+	for(auto field = 0u; field < num_fields; ++field)
+	{
+		if(fields & (1 << field))
+		{
+			_set_by[field][cell] = std::uint32_t(index + 1);
+			_read_before[field][cell] = _read_by[cell];
+		}
+	}
+}
+
+// whether the command at 'index' writes anything to 'cell' that isn't overwritten later, without being read first.
+//   only the last read before the last cover is known; anything before that read is considered live
+inline bool DrawList::live(std::size_t index, std::uint8_t fields, std::size_t cell) const
+{
+	for(auto field = 0u; field < num_fields; ++field)
+	{
+		if((fields & (1 << field)) and (_set_by[field][cell] <= index + 1 or _read_before[field][cell] > index + 1))
+			return true;
+	}
+	return false;
+}
+
+bool DrawList::live(std::size_t index, const Command &cmd, const ScreenBuffer &buffer) const
+{
+	const auto fields = writes(cmd);
+
+	if(const auto *p = std::get_if<Print>(&cmd); p)
+	{
+		bool any { false };
+		buffer.dry_print({ { 0, 0 }, buffer.size() }, p->pos, p->text, [&](Pos pos) {
+			any = any or live(index, fields, pos.y*_stride + pos.x);
+		});
+		return any;
+	}
+
+	const auto &rect = std::get<Clear>(cmd).rect;
+	const auto area = rect.intersected({ { 0, 0 }, buffer.size() });
+
+	for(auto y = area.top_left.y; y < area.top_left.y + area.size.height; ++y)
+	{
+		for(auto x = area.top_left.x; x < area.top_left.x + area.size.width; ++x)
+		{
+			if(live(index, fields, y*_stride + x))
+				return true;
+		}
+	}
+	return false;
+}
+
+void DrawList::play(ScreenBuffer &buffer)
+{
+	if(_commands.empty())
+		return;
+
+	const auto size = buffer.size();
+	_stride = size.width;
+
+	for(auto &set_by: _set_by)
+		set_by.assign(size.area(), 0);
+	for(auto &read_before: _read_before)
+		read_before.assign(size.area(), 0);
+	_read_by.assign(size.area(), 0);
+
+	// first pass: which command is the last to completely set (or to read) each field of each cell
+	for(std::size_t index = 0; index < _commands.size(); ++index)
+	{
+		const auto &cmd = _commands[index];
+
+		if(reads(cmd))
+		{
+			const auto area = std::visit([](const auto &c) -> Rectangle {
+				if constexpr (requires { c.rect; })
+					return c.rect;
+				else
+					return {};
+			}, cmd).intersected({ { 0, 0 }, size });
+
+			for(auto y = area.top_left.y; y < area.top_left.y + area.size.height; ++y)
+			{
+				for(auto x = area.top_left.x; x < area.top_left.x + area.size.width; ++x)
+					_read_by[y*_stride + x] = std::uint32_t(index + 1);
+			}
+			continue;
+		}
+
+		const auto fields = covers(cmd);
+		if(fields == 0)
+			continue;
+
+		if(const auto *p = std::get_if<Print>(&cmd); p)
+		{
+			buffer.dry_print({ { 0, 0 }, size }, p->pos, p->text, [&](Pos pos) {
+				cover(index, fields, pos.y*_stride + pos.x);
+			});
+			continue;
+		}
+
+		const auto &rect = std::holds_alternative<Clear>(cmd)? std::get<Clear>(cmd).rect: std::get<Fill>(cmd).rect;
+		const auto area = rect.intersected({ { 0, 0 }, size });
+
+		for(auto y = area.top_left.y; y < area.top_left.y + area.size.height; ++y)
+		{
+			for(auto x = area.top_left.x; x < area.top_left.x + area.size.width; ++x)
+				cover(index, fields, y*_stride + x);
+		}
+	}
+
+	// second pass: draw what's still visible, in order
+	for(std::size_t index = 0; index < _commands.size(); )
+	{
+		const auto &cmd = _commands[index];
+
+		if(const auto *c = std::get_if<Clear>(&cmd); c)
+		{
+			if(c->rect.intersected({ { 0, 0 }, size }).size == size)
+				buffer.clear(c->bg, c->fg);  // cheap; a full clear is lazy
+			else if(live(index, cmd, buffer))
+				buffer.clear(c->rect, c->bg, c->fg);
+			++index;
+		}
+		else if(const auto *p = std::get_if<Print>(&cmd); p)
+		{
+			if(live(index, cmd, buffer))
+				buffer.print(p->pos, p->text, p->lk);
+			++index;
+		}
+		else
+		{
+			// row operations on the same rectangle are done together
+			const auto rect = std::visit([](const auto &c) -> Rectangle {
+				if constexpr (requires { c.rect; })
+					return c.rect;
+				else
+					return {};
+			}, cmd);
+
+			auto last = index + 1;
+			while(last < _commands.size()
+				  and not std::holds_alternative<Clear>(_commands[last])
+				  and not std::holds_alternative<Print>(_commands[last])
+				  and std::visit([&rect](const auto &c) {
+						if constexpr (requires { c.rect; })
+							return c.rect == rect;
+						else
+							return false;
+					}, _commands[last]))
+			{
+				++last;
+			}
+
+			play_rows(index, last, buffer);
+			index = last;
+		}
+	}
+
+	_commands.clear();
+}
+
+// draw the row operations [first, last) (all on the same rectangle), one row at a time,
+//   skipping runs of cells where their results would be overwritten anyway
+void DrawList::play_rows(std::size_t first, std::size_t last, ScreenBuffer &buffer)
+{
+	const auto rect = std::visit([](const auto &c) -> Rectangle {
+		if constexpr (requires { c.rect; })
+			return c.rect;
+		else
+			return {};
+	}, _commands[first]);
+
+	const auto area = rect.intersected({ { 0, 0 }, buffer.size() });
+	if(area.area() == 0)
+		return;
+
+	// u & v are in (0, 1], relative to the whole (unclipped) rectangle
+	const auto du = 1.f / float(rect.size.width);
+	const auto dv = 1.f / float(rect.size.height);
+	const auto u0 = float(area.top_left.x - rect.top_left.x + 1)*du;
+	const auto row0 = area.top_left.y - rect.top_left.y;
+
+	bool parallel { false };
+	for(auto index = first; index < last; ++index)
+	{
+		std::visit([&parallel](const auto &c) {
+			if constexpr (requires { c.parallel; })
+				parallel = parallel or c.parallel;
+		}, _commands[index]);
+	}
+
+	auto band = [&](std::size_t first_row, std::size_t last_row) {
+		std::vector<Color> colors(area.size.width);
+
+		for(auto row = first_row; row < last_row; ++row)
+		{
+			const auto y = area.top_left.y + row;
+			const auto v = std::min(1.f, float(row0 + row + 1)*dv);
+			auto cells = buffer.span({ area.top_left.x, y }, area.size.width);
+			const auto cell0 = y*_stride + area.top_left.x;
+
+			for(auto index = first; index < last; ++index)
+			{
+				const auto &cmd = _commands[index];
+				const auto fields = writes(cmd);
+
+				// each run of cells that will still be visible
+				for(std::size_t x = 0; x < cells.size(); )
+				{
+					if(not live(index, fields, cell0 + x))
+					{
+						++x;
+						continue;
+					}
+					auto run_end = x + 1;
+					while(run_end < cells.size() and live(index, fields, cell0 + run_end))
+						++run_end;
+
+					const auto run = cells.subspan(x, run_end - x);
+					const auto u = std::min(1.f, u0 + float(x)*du);
+
+					if(const auto *f = std::get_if<Fill>(&cmd); f)
+					{
+						for(auto &cell: run)
+						{
+							cell.width = 1;
+							if(f->c != color::NoChange)
+								cell.look.bg = f->c;
+						}
+					}
+					else if(const auto *s = std::get_if<Sample>(&cmd); s)
+					{
+						s->sampler->sample_row(v, u, du, run.size(), colors.data(), s->angle);
+						for(std::size_t idx = 0; idx < run.size(); ++idx)
+						{
+							run[idx].width = 1;
+							if(colors[idx] != color::NoChange)
+								run[idx].look.bg = colors[idx];
+						}
+					}
+					else if(const auto *f = std::get_if<Filter>(&cmd); f)
+						f->f(run, { u, v }, du);
+					else if(const auto *f = std::get_if<Fade>(&cmd); f)
+						buffer.fade({ { area.top_left.x + x, y }, { run.size(), 1 } }, f->fg, f->bg, f->blend);
+					else if(const auto *c = std::get_if<Composite>(&cmd); c)
+						buffer.composite({ { area.top_left.x + x, y }, { run.size(), 1 } }, c->fg, c->bg);
+
+					x = run_end;
+				}
+			}
+		}
+	};
+
+	if(parallel)
+		parallel::for_bands(area.size.height, 4096/area.size.width, band);
+	else
+		band(0, area.size.height);
+}
+
+} // NS: termic
@@ -0,0 +1,220 @@
+#!/usr/bin/env perl
+#
+# generates the Unicode lookup tables used by utf8.h, from the Unicode database that comes with perl.
+#   usage: gen-unicode-tables.pl <output.cpp>
+#
+# the tables follow the Unicode version of the perl that runs this (i.e. of the build host), which is noted in the output;
+#   builds with different perls may disagree on the widths & properties of recently added characters.
+#
+# character widths follow Markus Kuhn's wcwidth() (see extern/mk-wcwidth), with current data:
+#   -1: control characters
+#    0: NUL, combining & enclosing marks, format characters (except soft hyphen), Hangul medial vowels & final consonants
+#    2: East Asian Wide & Fullwidth (which includes emoji presentation characters), CJK planes 2 & 3
+#    1: everything else
+#
+# line breaking classes (UAX #14) are resolved as far as they can be without knowing the BreakMode:
+#   XX & SG become AL, SA marks become CM.  AI, CJ & SA are left for text::LineBreaker.
+#
+# grapheme cluster break properties (UAX #29) have Extended_Pictographic folded in, as it only ever applies to 'Other'.
+#
+# the tables are two-level: '*_index' maps the high bits of a codepoint to a block of 256 values,
+#   identical blocks are stored only once.
+
+use strict;
+use warnings;
+
+use Unicode::UCD qw(prop_invlist prop_invmap);
+
+my $output = shift or die "usage: $0 <output.cpp>\n";
+
+my $num_codepoints = 0x110000;
+my $block_size = 256;
+
+my @width = (1) x $num_codepoints;
+
+sub set_range
+{
+	my ($value, $first, $last) = @_;
+	@width[$first .. $last] = ($value) x ($last - $first + 1);
+}
+
+sub set_property
+{
+	my ($value, $property) = @_;
+	my @invlist = prop_invlist($property) or die "unknown property: $property\n";
+
+	for(my $idx = 0; $idx < @invlist; $idx += 2)
+	{
+		my $end = $idx + 1 < @invlist? $invlist[$idx + 1]: $num_codepoints;
+		set_range($value, $invlist[$idx], $end - 1);
+	}
+}
+
+# later assignments override earlier ones
+set_property(2, 'East_Asian_Width=Wide');
+set_property(2, 'East_Asian_Width=Fullwidth');
+set_range(2, 0x20000, 0x2fffd);
+set_range(2, 0x30000, 0x3fffd);
+
+set_property(0, 'General_Category=Nonspacing_Mark');
+set_property(0, 'General_Category=Enclosing_Mark');
+set_property(0, 'General_Category=Format');
+set_range(0, 0x1160, 0x11ff);
+set_range(0, 0xd7b0, 0xd7ff);
+$width[0x00ad] = 1;
+
+set_property(-1, 'General_Category=Control');
+$width[0] = 0;
+
+
+# the order of utf8::LineBreak
+my @line_break_classes = qw(
+	OP CL CP QU GL NS EX SY IS PR PO NU AL HL ID IN HY BA BB B2 ZW CM WJ H2 H3 JL JV JT RI EB EM ZWJ CB
+	BK CR LF NL SP AI CJ SA
+);
+my %line_break_value;
+@line_break_value{@line_break_classes} = (0 .. $#line_break_classes);
+
+my @line_break = ($line_break_value{AL}) x $num_codepoints;
+{
+	my ($ranges, $classes) = prop_invmap('Line_Break');
+	my %is_mark;
+	for my $gc ('Nonspacing_Mark', 'Spacing_Mark')
+	{
+		my @invlist = prop_invlist("General_Category=$gc");
+		for(my $idx = 0; $idx < @invlist; $idx += 2)
+		{
+			my $end = $idx + 1 < @invlist? $invlist[$idx + 1]: $num_codepoints;
+			$is_mark{$_} = 1 for $invlist[$idx] .. $end - 1;
+		}
+	}
+
+	for(my $idx = 0; $idx < @$ranges; ++$idx)
+	{
+		my $class = $classes->[$idx];
+		next if $class eq 'Unknown' or $class eq 'XX' or $class eq 'SG';
+		die "unknown line break class: $class\n" unless exists $line_break_value{$class};
+
+		my $end = $idx + 1 < @$ranges? $ranges->[$idx + 1]: $num_codepoints;
+		for my $cp ($ranges->[$idx] .. $end - 1)
+		{
+			my $c = ($class eq 'SA' and $is_mark{$cp})? 'CM': $class;
+			$line_break[$cp] = $line_break_value{$c};
+		}
+	}
+}
+
+
+# the order of utf8::GraphemeBreak
+my @grapheme_break_values = qw(
+	Other CR LF Control Extend ZWJ Regional_Indicator Prepend SpacingMark L V T LV LVT Extended_Pictographic
+);
+my %grapheme_break_value;
+@grapheme_break_value{@grapheme_break_values} = (0 .. $#grapheme_break_values);
+
+my @grapheme_break = ($grapheme_break_value{Other}) x $num_codepoints;
+{
+	my ($ranges, $values) = prop_invmap('Grapheme_Cluster_Break');
+
+	for(my $idx = 0; $idx < @$ranges; ++$idx)
+	{
+		my $value = $values->[$idx];
+		$value = 'Extended_Pictographic' if $value eq 'ExtPict_XX';  # perl's name for the combination
+		next if $value eq 'Other';
+		die "unknown grapheme cluster break: $value\n" unless exists $grapheme_break_value{$value};
+
+		my $end = $idx + 1 < @$ranges? $ranges->[$idx + 1]: $num_codepoints;
+		@grapheme_break[$ranges->[$idx] .. $end - 1] = ($grapheme_break_value{$value}) x ($end - $ranges->[$idx]);
+	}
+
+	my @invlist = prop_invlist('Extended_Pictographic');
+	for(my $idx = 0; $idx < @invlist; $idx += 2)
+	{
+		my $end = $idx + 1 < @invlist? $invlist[$idx + 1]: $num_codepoints;
+		for my $cp ($invlist[$idx] .. $end - 1)
+		{
+			$grapheme_break[$cp] = $grapheme_break_value{Extended_Pictographic} if $grapheme_break[$cp] == $grapheme_break_value{Other};
+		}
+	}
+}
+
+
+open(my $out, '>', $output) or die "$output: $!\n";
+
+my $version = Unicode::UCD::UnicodeVersion();
+
+print $out <<"END";
+// generated by gen-unicode-tables.pl, from Unicode $version.  do not edit.
+
+#include <termic/utf8.h>
+
+namespace termic
+{
+
+namespace utf8
+{
+
+namespace tables
+{
+END
+
+# split into blocks, keeping only unique ones
+sub write_table
+{
+	my ($name, $type, @values) = @_;
+
+	my @blocks;
+	my %block_ids;
+	my @index;
+
+	for(my $first = 0; $first < $num_codepoints; $first += $block_size)
+	{
+		my $block = join(', ', @values[$first .. $first + $block_size - 1]);
+		if(not exists $block_ids{$block})
+		{
+			$block_ids{$block} = scalar @blocks;
+			push @blocks, $block;
+		}
+		push @index, $block_ids{$block};
+	}
+
+	die "$name: too many unique blocks\n" if @blocks > 256;
+
+	my $num_blocks = scalar @blocks;
+	my $index_size = scalar @index;
+
+	print $out "\nconst std::uint8_t ${name}_index[$index_size] = {\n";
+	for(my $idx = 0; $idx < @index; $idx += 32)
+	{
+		my $last = $idx + 31 < $#index? $idx + 31: $#index;
+		print $out "\t", join(', ', @index[$idx .. $last]), ",\n";
+	}
+
+	print $out "};\n\nconst $type ${name}_blocks[$num_blocks][$block_size] = {\n";
+	for my $block (@blocks)
+	{
+		my @block_values = split(/, /, $block);
+		print $out "\t{\n";
+		for(my $idx = 0; $idx < @block_values; $idx += 32)
+		{
+			print $out "\t\t", join(', ', @block_values[$idx .. $idx + 31]), ",\n";
+		}
+		print $out "\t},\n";
+	}
+	print $out "};\n";
+}
+
+write_table('width', 'std::int8_t', @width);
+write_table('line_break', 'std::uint8_t', @line_break);
+write_table('grapheme_break', 'std::uint8_t', @grapheme_break);
+
+print $out <<"END";
+
+} // NS: tables
+
+} // NS: utf8
+
+} // NS: termic
+END
+
+close($out) or die "$output: $!\n";
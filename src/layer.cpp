@@ -0,0 +1,173 @@
+#include <termic/layer.h>
+
+#include <algorithm>
+
+
+namespace termic
+{
+
+const Cell Layer::transparent = [] {
+	Cell c {};  // no content and width 0
+	c.look = Look(color::NoChange, style::NoChange, color::NoChange);
+	return c;
+}();
+
+Layer::Layer(Rectangle rect, int z) :
+	_pos(rect.top_left),
+	_z(z)
+{
+	_buffer.set_size(rect.size);
+	_buffer.clear(transparent);
+	invalidate();
+}
+
+void Layer::move(Pos top_left)
+{
+	if(top_left.x == _pos.x and top_left.y == _pos.y)
+		return;
+
+	expose(rect());
+	_pos = top_left;
+	invalidate();
+}
+
+void Layer::set_visible(bool visible)
+{
+	if(visible == _visible)
+		return;
+
+	_visible = visible;
+	expose(rect());
+}
+
+void Layer::set_opacity(float opacity)
+{
+	const auto alpha = color::rgba(color::White, opacity).a;
+	if(alpha == _alpha)
+		return;
+
+	_alpha = alpha;
+	invalidate();
+}
+
+void Layer::clear()
+{
+	_buffer.clear(transparent);
+	invalidate();
+}
+
+void Layer::clear(Color bg, Color fg)
+{
+	_buffer.clear(bg, fg);
+	invalidate();
+}
+
+void Layer::clear(Rectangle rect, Color bg, Color fg)
+{
+	_buffer.clear(rect, bg, fg);
+	damage(rect);
+}
+
+void Layer::set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk)
+{
+	if(pos.x >= size().width or pos.y >= size().height)
+		return;
+
+	// changing only the look of a transparent cell keeps its content transparent
+	if(ch == Cell::NoChange and _buffer.cell(pos).width == 0 and _buffer.cell(pos).ch[0] == '\0')
+		width = 0;
+
+	_buffer.set_cell(pos, ch, width, lk);
+	damage({ pos, { std::max(1ul, width), 1 } });
+}
+
+std::size_t Layer::print(Pos pos, std::string_view s, Look lk)
+{
+	Pos end { pos };
+	const auto width = _buffer.print(pos, s, lk, &end);
+
+	damage({ { 0, pos.y }, { size().width, end.y - pos.y + 1 } });
+
+	return width;
+}
+
+void Layer::blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos)
+{
+	_buffer.blit(src, src_rect, dst_pos);
+	// the cells next to the blitted area might've been touched as well (wide characters)
+	damage({ { 0, dst_pos.y }, { size().width, src_rect.size.height } });
+}
+
+void Layer::invalidate()
+{
+	damage({ { 0, 0 }, size() });
+}
+
+void Layer::damage(Rectangle rect)
+{
+	_damage = _damage.united(rect.intersected({ { 0, 0 }, size() }));
+}
+
+void Layer::expose(Rectangle screen_rect)
+{
+	_exposed = _exposed.united(screen_rect);
+}
+
+Rectangle Layer::screen_damage() const
+{
+	auto damaged = _exposed;
+
+	if(_visible and _damage.area() > 0)
+		damaged = damaged.united(_damage.move({ int(_pos.x), int(_pos.y) }));
+
+	return damaged;
+}
+
+void Layer::composite(ScreenBuffer &dst, Rectangle area) const
+{
+	area = area.intersected(rect()).intersected({ { 0, 0 }, dst.size() });
+	if(area.area() == 0)
+		return;
+
+	const auto count = area.size.width;
+
+	for(auto y = area.top_left.y; y <= area.bottom(); ++y)
+	{
+		const Pos src_pos { area.top_left.x - _pos.x, y - _pos.y };
+		auto dst_span = dst.span({ area.top_left.x, y }, count);
+
+		for(std::size_t x = 0; x < count; ++x)
+		{
+			const auto &src = _buffer.cell({ src_pos.x + x, src_pos.y });
+			auto &cell = dst_span[x];
+
+			// transparent cells have neither characters nor width
+			const auto has_content = src.ch[0] != '\0' or src.width != 0;
+			if(has_content)
+			{
+				std::copy_n(src.ch, sizeof(src.ch), cell.ch);
+				cell.width = src.width;
+			}
+
+			const auto style_mask = src.look.style == style::NoChange? Style(0): Style(~0u);
+			cell.look.style = static_cast<Style>((cell.look.style & ~style_mask) | (src.look.style & style_mask));
+
+			if(_alpha == 255)
+			{
+				const auto fg_mask = src.look.fg == color::NoChange? Color(0): ~Color(0);
+				const auto bg_mask = src.look.bg == color::NoChange? Color(0): ~Color(0);
+
+				cell.look.fg = (cell.look.fg & ~fg_mask) | (src.look.fg & fg_mask);
+				cell.look.bg = (cell.look.bg & ~bg_mask) | (src.look.bg & bg_mask);
+			}
+			else
+			{
+				// NoChange is fully transparent
+				cell.look.fg = color::over(color::with_alpha(src.look.fg, _alpha), cell.look.fg);
+				cell.look.bg = color::over(color::with_alpha(src.look.bg, _alpha), cell.look.bg);
+			}
+		}
+	}
+}
+
+} // NS: termic
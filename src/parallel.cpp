@@ -0,0 +1,206 @@
+#include <termic/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace termic
+{
+
+namespace parallel
+{
+
+struct Job
+{
+	const std::function<void (std::size_t, std::size_t)> &f;
+	std::size_t count;
+	std::size_t band;
+	std::size_t num_bands;
+	std::atomic<std::size_t> next { 0 };
+};
+
+// set while a thread runs bands (always, on the pool's threads), so that nested calls run serially
+//   instead of waiting for the pool they're running on
+static thread_local bool t_in_bands { false };
+
+struct Pool
+{
+	Pool();
+	~Pool();
+
+	void execute(Job &job);
+	inline std::size_t size() const { return _workers.size(); }
+	// waits for the current job (if any)
+	void resize(std::size_t num_workers);
+	static std::size_t default_size();
+
+private:
+	void start(std::size_t num_workers);
+	void stop();
+	void run();
+	static void work(Job &job);
+
+private:
+	std::vector<std::thread> _workers;
+
+	std::mutex _submit;  // one job at a time
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _idle;
+	Job *_job { nullptr };
+	std::uint64_t _generation { 0 };
+	std::size_t _busy { 0 };
+	bool _stopping { false };
+};
+
+Pool::Pool()
+{
+	start(default_size());
+}
+
+Pool::~Pool()
+{
+	stop();
+}
+
+std::size_t Pool::default_size()
+{
+	// a few threads is plenty for what a terminal can show
+	return std::min(7u, std::max(1u, std::thread::hardware_concurrency()) - 1);
+}
+
+void Pool::start(std::size_t num_workers)
+{
+	_stopping = false;
+	for(auto idx = 0u; idx < num_workers; ++idx)
+		_workers.emplace_back([this]() { run(); });
+}
+
+void Pool::stop()
+{
+	{
+		std::unique_lock lock(_mutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+
+	for(auto &worker: _workers)
+		worker.join();
+	_workers.clear();
+}
+
+void Pool::resize(std::size_t num_workers)
+{
+	std::unique_lock submit_lock(_submit);
+
+	stop();
+	start(num_workers);
+}
+
+void Pool::execute(Job &job)
+{
+	std::unique_lock submit_lock(_submit);
+
+	{
+		std::unique_lock lock(_mutex);
+		_job = &job;
+		++_generation;
+	}
+	_wake.notify_all();
+
+	work(job);
+
+	// wait for the workers that picked up the job; after this, no one else will
+	std::unique_lock lock(_mutex);
+	_job = nullptr;
+	_idle.wait(lock, [this]() { return _busy == 0; });
+}
+
+void Pool::run()
+{
+	t_in_bands = true;
+
+	std::uint64_t seen { 0 };
+
+	while(true)
+	{
+		std::unique_lock lock(_mutex);
+		_wake.wait(lock, [this, seen]() { return _stopping or _generation != seen; });
+		if(_stopping)
+			return;
+
+		seen = _generation;
+		auto *job = _job;
+		if(not job)  // already finished
+			continue;
+
+		++_busy;
+		lock.unlock();
+
+		work(*job);
+
+		lock.lock();
+		if(--_busy == 0)
+			_idle.notify_all();
+	}
+}
+
+void Pool::work(Job &job)
+{
+	for(auto idx = job.next++; idx < job.num_bands; idx = job.next++)
+	{
+		const auto first = idx*job.band;
+		job.f(first, std::min(job.count, first + job.band));
+	}
+}
+
+static Pool &pool()
+{
+	static Pool p;
+	return p;
+}
+
+void for_bands(std::size_t count, std::size_t min_band, const std::function<void (std::size_t, std::size_t)> &f)
+{
+	if(count == 0)
+		return;
+
+	min_band = std::max(1ul, min_band);
+
+	const auto threads = t_in_bands? 1: concurrency();
+	const auto num_bands = std::min(threads, std::max(1ul, count / min_band));
+
+	if(num_bands <= 1)
+		return f(0, count);
+
+	// one band per thread; they're all (roughly) equally expensive
+	const auto band = (count + num_bands - 1) / num_bands;
+	Job job { f, count, band, (count + band - 1) / band };
+
+	// the calling thread works on the job too
+	struct InBands
+	{
+		InBands() { t_in_bands = true; }
+		~InBands() { t_in_bands = false; }
+	} in_bands;
+
+	pool().execute(job);
+}
+
+std::size_t concurrency()
+{
+	return pool().size() + 1;
+}
+
+void set_concurrency(std::size_t threads)
+{
+	pool().resize(threads == 0? Pool::default_size(): threads - 1);
+}
+
+} // NS: parallel
+
+} // NS: termic
@@ -0,0 +1,220 @@
+#include <termic/pixel-canvas.h>
+#include <termic/screen-buffer.h>
+
+#include <algorithm>
+#include <string_view>
+
+using namespace std::literals;
+
+namespace termic
+{
+
+PixelCanvas::PixelCanvas(Size cells, Mode mode) :
+	_mode(mode),
+	_cell_width(mode == Braille? 2: 1),
+	_cell_height(mode == Braille? 4: 2)
+{
+	set_size(cells);
+}
+
+void PixelCanvas::set_size(Size cells)
+{
+	_width = cells.width*_cell_width;
+	_height = cells.height*_cell_height;
+
+	_pixels.assign(_width*_height, color::Black);
+	_dirty.assign(cells.area(), 1);
+}
+
+void PixelCanvas::clear(Color c)
+{
+	fill({ { 0, 0 }, size() }, c);
+}
+
+void PixelCanvas::fill(Rectangle rect, Color c)
+{
+	rect = rect.intersected({ { 0, 0 }, size() });
+
+	for(auto y = rect.top_left.y; y < rect.top_left.y + rect.size.height; ++y)
+	{
+		for(auto x = rect.top_left.x; x < rect.top_left.x + rect.size.width; ++x)
+			set_pixel({ x, y }, c);
+	}
+}
+
+std::span<Color> PixelCanvas::row(std::size_t y)
+{
+	if(y >= _height)
+		return {};
+
+	const auto cols = _width / _cell_width;
+	const auto dirty = _dirty.begin() + std::ptrdiff_t((y / _cell_height)*cols);
+	std::fill(dirty, dirty + std::ptrdiff_t(cols), std::uint8_t(1));
+
+	return { _pixels.data() + y*_width, _width };
+}
+
+void PixelCanvas::invalidate()
+{
+	std::fill(_dirty.begin(), _dirty.end(), std::uint8_t(1));
+}
+
+void PixelCanvas::draw(ScreenBuffer &dst, Pos dst_pos)
+{
+	const auto all = &dst != _drawn_to or not (dst_pos == _drawn_pos) or dst.generation() != _drawn_generation;
+
+	const auto [cols, rows] = cell_size();
+	const auto dst_size = dst.size();
+
+	if(dst_pos.x < dst_size.width and dst_pos.y < dst_size.height)
+	{
+		const auto visible_rows = std::min(rows, dst_size.height - dst_pos.y);
+
+		for(std::size_t cy = 0; cy < visible_rows; ++cy)
+		{
+			const auto dirty = _dirty.begin() + std::ptrdiff_t(cy*cols);
+			if(not all and std::find(dirty, dirty + std::ptrdiff_t(cols), std::uint8_t(1)) == dirty + std::ptrdiff_t(cols))
+				continue;
+
+			if(_mode == HalfBlock)
+				draw_half_blocks(dst, dst_pos, cy, all);
+			else
+				draw_braille(dst, dst_pos, cy, all);
+		}
+	}
+
+	std::fill(_dirty.begin(), _dirty.end(), std::uint8_t(0));
+
+	_drawn_to = &dst;
+	_drawn_pos = dst_pos;
+	_drawn_generation = dst.generation();
+}
+
+static inline void set_ch(Cell &cell, std::string_view ch)
+{
+	std::copy_n(ch.data(), ch.size(), cell.ch);
+	cell.ch[ch.size()] = '\0';
+	cell.width = 1;
+}
+
+// converts one row of cells;  the top & bottom pixels become fg & bg of '▀'
+void PixelCanvas::draw_half_blocks(ScreenBuffer &dst, Pos dst_pos, std::size_t cy, bool all)
+{
+	const auto cols = _width;
+	const auto count = std::min(cols, dst.size().width - dst_pos.x);
+	const Pos row_pos { dst_pos.x, dst_pos.y + cy };
+
+	const auto *top = &_pixels[cy*2*_width];
+	const auto *bottom = top + _width;
+	const auto *dirty = &_dirty[cy*cols];
+
+	auto cells = dst.span(row_pos, count);
+
+	for(std::size_t x = 0; x < count; ++x)
+	{
+		if(not all and not dirty[x])
+			continue;
+
+		auto &cell = cells[x];
+		if(top[x] == bottom[x])
+			set_ch(cell, " "sv);
+		else
+			set_ch(cell, "▀"sv);
+		cell.look = { top[x], bottom[x], style::Default };
+	}
+
+	dst.fix_wide_edges(row_pos, count);
+}
+
+// the average of the colors in 'pixels' selected by 'mask'
+static Color average(const Color *pixels, std::uint8_t mask)
+{
+	std::uint32_t r { 0 }, g { 0 }, b { 0 }, n { 0 };
+	for(auto idx = 0u; idx < 8; ++idx)
+	{
+		if(mask & (1 << idx))
+		{
+			r += color::red(pixels[idx]);
+			g += color::green(pixels[idx]);
+			b += color::blue(pixels[idx]);
+			++n;
+		}
+	}
+	if(n == 0)
+		return color::Black;
+
+	return color::rgb(std::uint8_t(r / n), std::uint8_t(g / n), std::uint8_t(b / n));
+}
+
+// converts one row of cells;  each 2x4 block becomes a braille pattern
+void PixelCanvas::draw_braille(ScreenBuffer &dst, Pos dst_pos, std::size_t cy, bool all)
+{
+	const auto cols = _width / 2;
+	const auto count = std::min(cols, dst.size().width - dst_pos.x);
+	const Pos row_pos { dst_pos.x, dst_pos.y + cy };
+
+	const auto *dirty = &_dirty[cy*cols];
+	const auto *rows = &_pixels[cy*4*_width];
+
+	auto cells = dst.span(row_pos, count);
+
+	// the brightness of all pixels of the row of cells first, in one flat loop (which the compiler vectorises)
+	_luma.resize(4*_width);
+	for(std::size_t idx = 0; idx < _luma.size(); ++idx)
+	{
+		const auto c = rows[idx];
+		_luma[idx] = 2u*color::red(c) + 5u*color::green(c) + color::blue(c);
+	}
+
+	// bit of each pixel in a braille pattern, in the order of 'block' below
+	static constexpr std::uint8_t dot_bits[8] { 0x01, 0x08, 0x02, 0x10, 0x04, 0x20, 0x40, 0x80 };
+
+	for(std::size_t x = 0; x < count; ++x)
+	{
+		if(not all and not dirty[x])
+			continue;
+
+		Color block[8];
+		std::uint32_t luma[8];
+		std::uint32_t total_luma { 0 };
+		for(auto idx = 0u; idx < 8; ++idx)
+		{
+			const auto offset = (idx / 2)*_width + x*2 + idx % 2;
+			block[idx] = rows[offset];
+			luma[idx] = _luma[offset];
+			total_luma += luma[idx];
+		}
+
+		// pixels brighter than average are dots
+		std::uint8_t on { 0 };
+		std::uint32_t pattern { 0 };
+		for(auto idx = 0u; idx < 8; ++idx)
+		{
+			if(luma[idx]*8 > total_luma)
+			{
+				on = std::uint8_t(on | (1 << idx));
+				pattern |= dot_bits[idx];
+			}
+		}
+
+		if(pattern == 0)
+		{
+			set_ch(cells[x], " "sv);
+			cells[x].look = { color::Black, average(block, 0xff), style::Default };
+			continue;
+		}
+
+		// U+2800 + pattern, as UTF-8
+		const char ch[3] {
+			char(0xe2),
+			char(0xa0 | (pattern >> 6)),
+			char(0x80 | (pattern & 0x3f)),
+		};
+		set_ch(cells[x], { ch, 3 });
+		cells[x].look = { average(block, on), average(block, std::uint8_t(~on)), style::Default };
+	}
+
+	dst.fix_wide_edges(row_pos, count);
+}
+
+} // NS: termic
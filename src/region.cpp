@@ -0,0 +1,106 @@
+#include <termic/region.h>
+#include <termic/text.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace termic
+{
+
+std::size_t Extent::resolve(std::size_t parent) const
+{
+	const auto value = std::lround(fraction*float(parent)) + offset;
+
+	return static_cast<std::size_t>(std::clamp(value, 0l, long(parent)));
+}
+
+Rectangle Geometry::resolve(Size parent) const
+{
+	return {
+		{ x.resolve(parent.width), y.resolve(parent.height) },
+		{ width.resolve(parent.width), height.resolve(parent.height) },
+	};
+}
+
+Region::Region(ScreenBuffer &buffer) :
+	Region(buffer, { { 0, 0 }, buffer.size() })
+{
+}
+
+Region::Region(ScreenBuffer &buffer, Rectangle rect) :
+	_buffer(buffer),
+	_rect(rect.intersected({ { 0, 0 }, buffer.size() }))
+{
+}
+
+Region Region::region(Rectangle rect) const
+{
+	return Region(_buffer, to_buffer(rect).intersected(_rect));
+}
+
+Region Region::region(const Geometry &geometry) const
+{
+	return region(geometry.resolve(size()));
+}
+
+void Region::clear(Color bg, Color fg)
+{
+	if(_rect.area() > 0)
+		_buffer.clear(_rect, bg, fg);
+}
+
+void Region::clear(Rectangle rect, Color bg, Color fg)
+{
+	rect.size.width = std::max(1ul, rect.size.width);
+	rect.size.height = std::max(1ul, rect.size.height);
+
+	rect = to_buffer(rect).intersected(_rect);
+	if(rect.area() > 0)
+		_buffer.clear(rect, bg, fg);
+}
+
+void Region::go_to(Pos pos)
+{
+	_cursor = pos;
+}
+
+std::size_t Region::print(Alignment align, Pos anchor_pos, std::string_view s, Look lk)
+{
+	Pos pos { anchor_pos };
+
+	if(align != Left and not s.empty())
+	{
+		const auto text_width = text::width(s);
+
+		if(align == Right)
+			pos.x -= std::min(pos.x, text_width - 1);  // anchor is last cell of the text
+		else if(align == Center)
+			pos.x -= std::min(pos.x, text_width/2);    // anchor is center of the text (truncated)
+	}
+
+	return print(pos, s, lk);
+}
+
+std::size_t Region::print(Pos pos, std::string_view s, Look lk)
+{
+	_cursor = pos;
+
+	if(pos.x >= _rect.size.width or pos.y >= _rect.size.height)
+		return 0;
+
+	Pos end { to_buffer(pos) };
+	const auto width = _buffer.print(_rect, to_buffer(pos), s, lk, &end);
+
+	_cursor = { end.x - _rect.top_left.x, end.y - _rect.top_left.y };
+
+	return width;
+}
+
+void Region::set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk)
+{
+	if(pos.x < _rect.size.width and pos.y < _rect.size.height)
+		_buffer.set_cell(to_buffer(pos), ch, width, lk);
+}
+
+} // NS: termic
@@ -15,11 +15,93 @@ namespace color
 
 [[maybe_unused]] static constexpr auto deg2rad = std::numbers::pi_v<float>/180.f;
 
+void Sampler::sample_row(float v, float u0, float du, std::size_t count, Color *out, float angle) const
+{
+	for(std::size_t idx = 0; idx < count; ++idx)
+		out[idx] = sample({ std::min(1.f, u0 + float(idx)*du), v }, angle);
+}
+
+void Constant::sample_row(float, float, float, std::size_t count, Color *out, float) const
+{
+	std::fill_n(out, count, _c);
+}
+
+// the angle-dependent part of sampling a gradient; the same for all samples of a fill.
+//   for a fixed angle, the gradient position is linear in u & v:  alpha = a0 + au*u + av*v
+struct LinearGradient::Direction
+{
+	Direction(float angle)
+	{
+		angle = std::fmod(std::fmod(angle, 360.f) + 360.f, 360.f); // ensure in range [0, 360]
+
+		// rotate the vector 'uv' by -_rotation degrees
+		auto degrees = angle;
+		bool flip_u { false };
+		bool flip_v { false };
+
+		if(degrees >= 270)
+		{
+			degrees = 360 - degrees;
+			flip_v = true;
+		}
+		else if(degrees >= 180)
+		{
+			degrees = degrees - 180;
+			flip_u = true;
+			flip_v = true;
+		}
+		else if(degrees >= 90)
+		{
+			degrees = 180 - degrees;
+			flip_u = true;
+		}
+
+		const auto radians = degrees*deg2rad;
+
+		const auto cos = std::cos(-radians);
+		const auto sin = std::sin(-radians);
+
+		// alpha = u'*cos - v'*sin,  where u' = 1 - u if flipped (v' likewise)
+		a0 = (flip_u? cos: 0.f) - (flip_v? sin: 0.f);
+		au = flip_u? -cos: cos;
+		av = flip_v? sin: -sin;
+
+		// this is definitely not the correct way to do it...
+		scale = std::max(std::abs(sin), std::abs(cos));
+	}
+
+	inline float alpha(UV uv) const
+	{
+		return (a0 + av*uv.v) + au*uv.u;
+	}
+
+	float a0 { 0 };
+	float au { 1 };
+	float av { 0 };
+	float scale { 1 };
+};
+
 LinearGradient::LinearGradient(std::initializer_list<Color> colors) :
 	_num_colors(0)
 {
 	for(const auto &c: colors)
-		_colors[_num_colors++] = c;
+	{
+		if(_num_colors < std::size(_colors))
+			_colors[_num_colors++] = c;
+	}
+
+	// no colors at all is the same as a single (default) color
+	if(_num_colors == 0)
+		_colors[_num_colors++] = color::Default;
+
+	// with a single color, the samples don't use a lookup table
+	if(_num_colors == 1)
+		return;
+
+	// pre-compute the colors along the gradient
+	_lut.resize(lut_size);
+	for(std::size_t idx = 0; idx < lut_size; ++idx)
+		_lut[idx] = interpolate(float(idx) / float(lut_size - 1));
 }
 
 void LinearGradient::set_offset(float offset)
@@ -34,54 +116,57 @@ Color LinearGradient::sample(UV uv, float angle) const
 	if(_num_colors == 1)
 		return _colors[0];
 
-	angle = std::fmod(std::fmod(angle, 360.f) + 360.f, 360.f); // ensure in range [0, 360]
+	const Direction dir(angle);
 
-	// rotate the vector 'uv' by -_rotation degrees
-	auto degrees = angle;
+	return color_at(dir.alpha(uv), dir.scale);
+}
 
-	if(degrees >= 270)
-	{
-		degrees = 360 - degrees;
-		uv.v = 1.f - uv.v;
-	}
-	else if(degrees >= 180)
-	{
-		degrees = degrees - 180;
-		uv.u = 1.f - uv.u;
-		uv.v = 1.f - uv.v;
-	}
-	else if(degrees >= 90)
+void LinearGradient::sample_row(float v, float u0, float du, std::size_t count, Color *out, float angle) const
+{
+	if(_num_colors == 1)
 	{
-		degrees = 180 - degrees;
-		uv.u = 1.f - uv.u;
+		std::fill_n(out, count, _colors[0]);
+		return;
 	}
 
-	auto radians = degrees*deg2rad;
+	// the angle only needs to be resolved once per row;
+	//   what remains per sample is a multiply-add and a table lookup
+	const Direction dir(angle);
 
-	auto alpha = uv.u*std::cos(-radians) - uv.v*std::sin(-radians);
+	const auto alpha_v = dir.a0 + dir.av*v;
 
+	for(std::size_t idx = 0; idx < count; ++idx)
+	{
+		const auto u = std::min(1.f, u0 + float(idx)*du);
+		out[idx] = color_at(alpha_v + dir.au*u, dir.scale);
+	}
+}
+
+Color LinearGradient::color_at(float alpha, float scale) const
+{
 	if(alpha == 0.f)
 		return _colors[0];
 	else if(alpha == 1.f)
 		return _colors[_num_colors - 1];
 
-	// this is definitely not the correct way to do it...
-	alpha *= std::max(std::abs(std::sin(-radians)), std::abs(std::cos(-radians)));
-
+	auto t = alpha*scale + _offset;
+	t -= std::floor(t);  // wrap into [0, 1)
 
-	alpha = std::fmod(alpha + _offset, 1.f);
+	return _lut[static_cast<std::size_t>(t*float(lut_size - 1) + 0.5f)];
+}
 
-	const auto idx = alpha*static_cast<float>(_num_colors - 1);
+Color LinearGradient::interpolate(float t) const
+{
+	const auto idx = t*static_cast<float>(_num_colors - 1);
 	const auto idx0 = static_cast<std::size_t>(std::floor(idx));
 
 	const auto blend = idx - float(idx0);
 	assert(blend >= 0 and blend <= 1);
 
 	const auto color0 = _colors[idx0];
-	if(idx0 == _num_colors - 1)
+	if(idx0 >= _num_colors - 1)
 		return color0;
 
-	assert(idx0 + 1 < _num_colors);
 	const auto color1 = _colors[idx0 + 1];
 
 	return lerp(color0, color1, blend);
@@ -1,86 +1,562 @@
 #include <termic/screen-buffer.h>
+#include <termic/utf8.h>
+
 
 #include <fmt/core.h>
 
+#include <algorithm>
+
 #include <assert.h>
 
 
+using namespace std::literals;
+
+static const std::size_t g_tab_width { 8 };
+
+
 namespace termic
 {
 extern std::FILE *g_log;
 
+// a template cell, and masks selecting which of its fields are applied to the target cells
+//   (the unused fields of 'cell' are zero, so applying a field is a plain and/or)
+struct ScreenBuffer::Fill
+{
+	Fill(std::string_view ch, std::size_t width, Look lk);
+	Fill(Color bg, Color fg, bool content);
+
+	inline bool complete() const
+	{
+		return content and width_mask == full_width and fg_mask == full_color and style_mask == full_style and bg_mask == full_color;
+	}
+
+	inline void apply(Cell &c) const
+	{
+		c.width    = static_cast<std::uint_fast8_t>((c.width & ~width_mask) | cell.width);
+		c.look.fg  = (c.look.fg & ~fg_mask) | cell.look.fg;
+		c.look.style = static_cast<Style>((c.look.style & ~style_mask) | cell.look.style);
+		c.look.bg  = (c.look.bg & ~bg_mask) | cell.look.bg;
+	}
+
+	static constexpr auto full_width = static_cast<std::uint_fast8_t>(~0u);
+	static constexpr auto full_color = ~Color(0);
+	static constexpr auto full_style = static_cast<Style>(~0u);
+
+	Cell cell {};
+	bool content { false };   // copy 'cell.ch'
+	std::uint_fast8_t width_mask { 0 };
+	Color fg_mask    { 0 };
+	Style style_mask { 0 };
+	Color bg_mask    { 0 };
+};
+
+ScreenBuffer::Fill::Fill(std::string_view ch, std::size_t width, Look lk) :
+	content(ch != Cell::NoChange),
+	width_mask(full_width),
+	fg_mask(lk.fg == color::NoChange? 0: full_color),
+	style_mask(lk.style == style::NoChange? 0: full_style),
+	bg_mask(lk.bg == color::NoChange? 0: full_color)
+{
+	if(content)
+	{
+		ch = Cell::fitting(ch);
+		std::copy_n(ch.data(), ch.size(), cell.ch);
+	}
+	cell.width = static_cast<std::uint_fast8_t>(width);
+	cell.look = Look(lk.fg & fg_mask, static_cast<Style>(lk.style & style_mask), lk.bg & bg_mask);
+}
+
+ScreenBuffer::Fill::Fill(Color bg, Color fg, bool content) :
+	content(content),
+	width_mask(content? full_width: 0),
+	fg_mask(fg == color::NoChange? 0: full_color),
+	style_mask(full_style),
+	bg_mask(bg == color::NoChange? 0: full_color)
+{
+	cell.width = content? 1: 0;
+	cell.look = Look(fg & fg_mask, style::Default, bg & bg_mask);
+}
+
+static inline void blank_out(Cell &c)
+{
+	c.ch[0] = '\0';
+	c.width = 1;
+}
+
+// the part of 'rect' that is inside 'size'  (an empty 'rect' counts as a single cell, as elsewhere)
+static Rectangle clipped(Rectangle rect, Size size)
+{
+	rect.size.width = std::max(1ul, rect.size.width);
+	rect.size.height = std::max(1ul, rect.size.height);
+
+	if(rect.top_left.x >= size.width or rect.top_left.y >= size.height)
+		return { rect.top_left, { 0, 0 } };
+
+	rect.size.width = std::min(rect.size.width, size.width - rect.top_left.x);
+	rect.size.height = std::min(rect.size.height, size.height - rect.top_left.y);
+
+	return rect;
+}
+
 void ScreenBuffer::clear(Color bg, Color fg, bool content)
 {
-	for(auto &cell: _buffer)
+	if(content and fg != color::NoChange and bg != color::NoChange)
+	{
+		// the result doesn't depend on the current content of any cell,
+		//   so just remember what a cleared cell looks like and let the rows catch up lazily
+		Cell blank {};
+		blank.width = 1;
+		blank.look = Look(fg, style::Default, bg);
+		return clear(blank);
+	}
+
+	// partial clear; cells keep some of their current state
+	fill({ { 0, 0 }, size() }, Fill(bg, fg, content));
+}
+
+void ScreenBuffer::clear(const Cell &blank)
+{
+	_blank = blank;
+	++_generation;
+}
+
+void ScreenBuffer::clear(Rectangle rect, Color bg, Color fg, bool content)
+{
+	fill(rect, Fill(bg, fg, content));
+}
+
+void ScreenBuffer::set_cells(Rectangle rect, std::string_view ch, std::size_t width, Look lk)
+{
+	fill(rect, Fill(ch, width, lk));
+}
+
+void ScreenBuffer::fill(Rectangle rect, const Fill &f)
+{
+	rect = clipped(rect, size());
+	if(rect.size.width == 0 or rect.size.height == 0)
+		return;
+
+	const auto complete = f.complete();
+
+	for(auto y = rect.top_left.y; y < rect.top_left.y + rect.size.height; ++y)
+	{
+		touch_row(y);
+
+		auto *span = &_buffer[y*_width + rect.top_left.x];
+		const auto span_end = span + rect.size.width;
+
+		if(complete)
+		{
+			std::fill(span, span_end, f.cell);
+			continue;
+		}
+
+		if(f.content)
+		{
+			for(auto *c = span; c != span_end; ++c)
+				std::copy_n(f.cell.ch, sizeof(c->ch), c->ch);
+		}
+		for(auto *c = span; c != span_end; ++c)
+			f.apply(*c);
+	}
+}
+
+// blend the fg & bg of a run of cells; one weight for the whole run, so the inner loop is just integer ops
+static void fade_span(Cell *span, Cell *span_end, Color fg, Color bg, std::uint32_t weight)
+{
+	if(fg != color::NoChange and bg != color::NoChange)
 	{
-		if(content)
+		for(auto *c = span; c != span_end; ++c)
 		{
-			cell.ch[0] = '\0';
-			cell.width = 1;
+			c->look.fg = color::mix(c->look.fg, fg, weight);
+			c->look.bg = color::mix(c->look.bg, bg, weight);
 		}
-		if(fg != color::NoChange)
-			cell.look.fg = fg;
-		cell.look.style = style::Default;
-		if(bg != color::NoChange)
-			cell.look.bg = bg;
+	}
+	else if(fg != color::NoChange)
+	{
+		for(auto *c = span; c != span_end; ++c)
+			c->look.fg = color::mix(c->look.fg, fg, weight);
+	}
+	else if(bg != color::NoChange)
+	{
+		for(auto *c = span; c != span_end; ++c)
+			c->look.bg = color::mix(c->look.bg, bg, weight);
 	}
 }
 
-void ScreenBuffer::clear(Rectangle rect, Color bg, Color fg, bool content)
+void ScreenBuffer::fade(Rectangle rect, Color fg, Color bg, float blend)
 {
-	rect.size.width = std::max(1ul, rect.size.width);
-	rect.size.height = std::max(1ul, rect.size.height);
+	const auto weight = color::mix_weight(blend);
+	if(weight == 0 or (fg == color::NoChange and bg == color::NoChange))
+		return;
+
+	rect = clipped(rect, size());
+	if(rect.size.width == 0 or rect.size.height == 0)
+		return;
+
+	// fading everything: rows that are still lazily cleared can stay that way, if the blank cell is faded as well
+	const auto everything = rect.size == size();
+	if(everything)
+		fade_span(&_blank, &_blank + 1, fg, bg, weight);
 
-	const auto &[width, height] = size();
+	for(auto y = rect.top_left.y; y < rect.top_left.y + rect.size.height; ++y)
+	{
+		if(everything and _row_generation[y] != _generation)
+			continue;
+
+		touch_row(y);
 
-	auto row_iter = _buffer.begin() + int(rect.top_left.y * _width);
+		auto *span = &_buffer[y*_width + rect.top_left.x];
+		fade_span(span, span + rect.size.width, fg, bg, weight);
+	}
+}
+
+void ScreenBuffer::composite(Rectangle rect, color::Rgba fg, color::Rgba bg)
+{
+	if(fg.a == 0 and bg.a == 0)
+		return;
 
-	for(auto y = rect.top_left.y; y <= rect.top_left.y + rect.size.height - 1 and y < height; ++y, std::advance(row_iter, _width))
+	rect = clipped(rect, size());
+
+	for(auto y = rect.top_left.y; y < rect.top_left.y + rect.size.height; ++y)
 	{
-		auto col_iter = row_iter + int(rect.top_left.x);
+		touch_row(y);
 
-		for(auto x = rect.top_left.x; x <= rect.top_left.x + rect.size.width - 1 and x < width; ++x, ++col_iter)
+		auto *span = &_buffer[y*_width + rect.top_left.x];
+		for(auto *c = span; c != span + rect.size.width; ++c)
 		{
-			auto &cell = *col_iter;
+			c->look.fg = color::over(fg, c->look.fg);
+			c->look.bg = color::over(bg, c->look.bg);
+		}
+	}
+}
 
-			if(content)
+void ScreenBuffer::set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk)
+{
+	if(pos.x >= _width or pos.y >= _height)
+		return;
+
+	this->cell(pos).set(ch, width, lk);
+}
+
+std::size_t ScreenBuffer::print(Pos pos, std::string_view s, Look lk, Pos *end)
+{
+	return print({ { 0, 0 }, size() }, pos, s, lk, end);
+}
+
+std::size_t ScreenBuffer::print(Rectangle clip, Pos pos, std::string_view s, Look lk, Pos *end)
+{
+	struct Writer
+	{
+		inline void row(std::size_t y) { cells = buffer.span({ 0, y }, buffer._width).data(); }
+		inline void put(std::size_t x, std::string_view ch, std::size_t width) { cells[x].set(ch, width, lk); }
+		inline void put_ascii(std::size_t x, std::string_view run)
+		{
+			for(const auto ch: run)
 			{
-				cell.ch[0] = '\0';
-				cell.width = 1;
+				auto &cell = cells[x++];
+				cell.ch[0] = ch;
+				cell.ch[1] = '\0';
+				cell.set(Cell::NoChange, 1, lk);
 			}
-			if(fg != color::NoChange)
-				cell.look.fg = fg;
-			cell.look.style = style::Default;
-			if(bg != color::NoChange)
-				cell.look.bg = bg;
 		}
+
+		ScreenBuffer &buffer;
+		Look lk;
+		Cell *cells { nullptr };
+	} writer { *this, lk };
+
+	return layout(clip, pos, s, writer, end);
+}
+
+std::size_t ScreenBuffer::dry_print(Rectangle clip, Pos pos, std::string_view s, const std::function<void (Pos)> &f, Pos *end) const
+{
+	struct Tracer
+	{
+		inline void row(std::size_t y_) { y = y_; }
+		inline void put(std::size_t x, std::string_view, std::size_t) { if(f) f({ x, y }); }
+		inline void put_ascii(std::size_t x, std::string_view run)
+		{
+			if(f)
+			{
+				for(auto end = x + run.size(); x < end; ++x)
+					f({ x, y });
+			}
+		}
+
+		const std::function<void (Pos)> &f;
+		std::size_t y { 0 };
+	} tracer { f };
+
+	return layout(clip, pos, s, tracer, end);
+}
+
+template<typename Sink>
+std::size_t ScreenBuffer::layout(Rectangle clip, Pos pos, std::string_view s, Sink &sink, Pos *end) const
+{
+	clip = clip.intersected({ { 0, 0 }, size() });
+
+	if(not clip.contains(pos))
+	{
+		if(g_log) fmt::print(g_log, "print: off-screen: {},{}\n", pos.x, pos.y);
+		return 0;
+	}
+
+	// limits are checked once per line; every cell written is inside 'clip'
+	const auto x_end = clip.top_left.x + clip.size.width;
+	const auto y_end = clip.top_left.y + clip.size.height;
+
+	auto cx = pos.x;
+	auto line_y = pos.y;
+	sink.row(pos.y);
+
+	auto max_width { 0ul };
+	auto curr_width { 0ul };
+
+	for(std::size_t offset = 0; offset < s.size(); )
+	{
+		// runs of plain ASCII are copied without decoding  (except the last character, if combining marks might follow)
+		auto run = utf8::ascii_run(s.substr(offset));
+		if(run > 0 and offset + run < s.size() and static_cast<std::uint8_t>(s[offset + run]) >= 0xcc)
+			--run;
+		if(run > 0)
+		{
+			if(cx < x_end)
+			{
+				const auto count = std::min(run, x_end - cx);
+				sink.put_ascii(cx, s.substr(offset, count));
+				curr_width += count;
+				cx += count;
+			}
+			offset += run;
+			continue;
+		}
+
+		const auto byte = s[offset];
+
+		if(byte == '\n')
+		{
+			++offset;
+			max_width = std::max(max_width, curr_width);
+			curr_width = 0;
+			cx = pos.x;
+			++pos.y;
+			if(pos.y >= y_end)
+				break;
+			line_y = pos.y;
+			sink.row(pos.y);
+			continue;
+		}
+		if(byte == '\t')  // jump to next tab stop (relative to the clip area)
+		{
+			++offset;
+			const auto col = cx - clip.top_left.x;
+			const auto tab_skip = ((col / g_tab_width) + 1) * g_tab_width - col;
+			curr_width += tab_skip;
+			cx = pos.x + curr_width;
+			continue;
+		}
+		if(byte == '\v')  // vertical tab (next line w/o carriage return)
+		{
+			++offset;
+			++pos.y;
+			if(pos.y >= y_end)
+				break;
+			line_y = pos.y;
+			sink.row(pos.y);
+			continue;
+		}
+		if(static_cast<std::uint8_t>(byte) < 0x20)  // other control characters aren't shown
+		{
+			++offset;
+			continue;
+		}
+
+		// a whole grapheme cluster goes into one cell
+		const auto cluster = utf8::read_cluster(s.substr(offset));
+		offset += cluster.sequence.size();
+
+		if(cx >= x_end)  // skip the rest of the line
+			continue;
+		if(cluster.width <= 0)  // nothing to show (e.g. a combining mark on its own)
+			continue;
+
+		const auto chwidth = static_cast<std::size_t>(cluster.width);
+
+		if(chwidth == 2 and cx == x_end - 1 and x_end < _width)
+		{
+			// the right half would end up outside the clip area; blank the cell instead  (an empty string wouldn't change it)
+			sink.put(cx, " "sv, 1);
+			cx = x_end;
+			continue;
+		}
+
+		// don't pass invalid bytes on to the terminal
+		sink.put(cx, utf8::is_invalid(cluster)? utf8::replacement_sequence: cluster.sequence, chwidth);
+
+		if(chwidth == 2 and cx < x_end - 1)
+		{
+			static const auto space { " "sv };
+			// set right-neighbour of double width cell to zero width
+			sink.put(cx + 1, space, 0);
+		}
+
+		curr_width += chwidth;
+
+		cx += static_cast<std::size_t>(chwidth);
 	}
+
+	if(end)
+		*end = { pos.x + curr_width, line_y };
+
+	max_width = std::max(max_width, curr_width);
+
+	return max_width;
 }
 
-void ScreenBuffer::set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk)
+void ScreenBuffer::blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos)
 {
-	if(pos.x >= _width or pos.y >= _height)
+	// nothing can be split by copying entire rows
+	const auto whole_rows = [this, &src](std::size_t width) { return width == _width and width == src._width; };
+
+	blit(src, src_rect, dst_pos, [this, whole_rows](std::span<Cell> dst, const Cell *first, std::size_t stride, Pos dst_row) {
+		if(stride == 0)
+			std::fill(dst.begin(), dst.end(), *first);
+		// might overlap, if blitting within the same buffer
+		else if(first >= dst.data())
+			std::copy(first, first + dst.size(), dst.begin());
+		else
+			std::copy_backward(first, first + dst.size(), dst.end());
+
+		if(not whole_rows(dst.size()))
+			fix_wide_edges(dst_row, dst.size());
+	});
+}
+
+void ScreenBuffer::blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos, float opacity)
+{
+	const auto a = color::rgba(color::White, opacity).a;
+	if(a == 255)
+		return blit(src, src_rect, dst_pos);
+	if(a == 0)
 		return;
 
-	auto &cell = this->cell(pos);
+	blit(src, src_rect, dst_pos, [this, a](std::span<Cell> dst, const Cell *first, std::size_t stride, Pos dst_row) {
+		auto composite = [&](std::size_t idx) {
+			const auto &s = first[idx*stride];
+			auto &d = dst[idx];
+
+			if(s.ch[0] != '\0')
+			{
+				std::copy_n(s.ch, sizeof(s.ch), d.ch);
+				d.width = s.width;
+				if(s.look.style != style::NoChange)
+					d.look.style = s.look.style;
+			}
+			d.look.fg = color::over(color::with_alpha(s.look.fg, a), d.look.fg);
+			d.look.bg = color::over(color::with_alpha(s.look.bg, a), d.look.bg);
+		};
+
+		// might overlap, if blitting within the same buffer
+		if(first >= dst.data())
+		{
+			for(std::size_t idx = 0; idx < dst.size(); ++idx)
+				composite(idx);
+		}
+		else
+		{
+			for(auto idx = dst.size(); idx > 0; --idx)
+				composite(idx - 1);
+		}
+
+		// characters were copied only to some cells, which may split double-width ones anywhere
+		fix_wide_cells(dst_row, dst.size());
+	});
+}
+
+// clip, then 'copy(dst_span, first_src_cell, src_stride, dst_row)' for each row  (a stride of 0 means all source cells are the same)
+template<typename CopyRow>
+void ScreenBuffer::blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos, CopyRow copy)
+{
+	const auto src_size = src.size();
+
+	if(src_rect.top_left.x >= src_size.width or src_rect.top_left.y >= src_size.height or dst_pos.x >= _width or dst_pos.y >= _height)
+		return;
+
+	const auto width = std::min({ src_rect.size.width, src_size.width - src_rect.top_left.x, _width - dst_pos.x });
+	const auto height = std::min({ src_rect.size.height, src_size.height - src_rect.top_left.y, _height - dst_pos.y });
+
+	if(width == 0)
+		return;
+
+	auto copy_row = [&](std::size_t row) {
+		const Pos src_row { src_rect.top_left.x, src_rect.top_left.y + row };
+		const Pos dst_row { dst_pos.x, dst_pos.y + row };
+
+		auto dst_span = span(dst_row, width);
 
-	if(ch != Cell::NoChange)
+		if(src._row_generation[src_row.y] != src._generation)  // cleared in 'src'; not materialized
+			copy(dst_span, &src._blank, 0, dst_row);
+		else
+			copy(dst_span, src._buffer.data() + src_row.y*src._width + src_row.x, 1, dst_row);
+	};
+
+	// when moving content downwards within the same buffer, start from the bottom
+	if(&src == this and dst_pos.y > src_rect.top_left.y)
+	{
+		for(auto row = height; row > 0; --row)
+			copy_row(row - 1);
+	}
+	else
 	{
-		std::strncpy(cell.ch, ch.data(), sizeof(cell.ch) - 1);
-		cell.ch[std::min(sizeof(cell.ch), ch.size())] = '\0';
+		for(std::size_t row = 0; row < height; ++row)
+			copy_row(row);
 	}
+}
 
-	cell.width = static_cast<std::uint_fast8_t>(width);
+void ScreenBuffer::fix_wide_edges(Pos pos, std::size_t count)
+{
+	if(count == 0 or pos.y >= _height or pos.x >= _width)
+		return;
+
+	touch_row(pos.y);
+
+	auto *row = &_buffer[pos.y*_width];
+	const auto first = pos.x;
+	const auto last = std::min(pos.x + count, _width) - 1;
+
+	// left half outside the span, right half inside (or vice versa)
+	if(first > 0 and row[first - 1].width == 2)
+		blank_out(row[first - 1]);
+	if(row[first].width == 0)
+		blank_out(row[first]);
+
+	// left half inside the span, right half outside (or vice versa)
+	if(row[last].width == 2)
+		blank_out(row[last]);
+	if(last + 1 < _width and row[last + 1].width == 0)
+		blank_out(row[last + 1]);
+}
 
-	if(lk.fg != color::NoChange)
-		cell.look.fg = lk.fg;
+void ScreenBuffer::fix_wide_cells(Pos pos, std::size_t count)
+{
+	if(count == 0 or pos.y >= _height or pos.x >= _width)
+		return;
 
-	if(lk.style != style::NoChange)
-		cell.look.style = lk.style;
+	touch_row(pos.y);
 
-	if(lk.bg != color::NoChange)
-		cell.look.bg = lk.bg;
+	auto *row = &_buffer[pos.y*_width];
+	const auto first = pos.x > 0? pos.x - 1: 0;
+	const auto last = std::min(pos.x + count, _width - 1);  // one past the span (if there is one)
 
+	for(auto x = first; x <= last; ++x)
+	{
+		// left half without a right half, or vice versa
+		if(row[x].width == 2 and (x + 1 == _width or row[x + 1].width != 0))
+			blank_out(row[x]);
+		else if(row[x].width == 0 and (x == 0 or row[x - 1].width != 2))
+			blank_out(row[x]);
+	}
 }
 
 ScreenBuffer &ScreenBuffer::operator = (const ScreenBuffer &src)
@@ -88,6 +564,9 @@ ScreenBuffer &ScreenBuffer::operator = (const ScreenBuffer &src)
 	assert(src.size().operator == (size()));
 
 	_buffer = src._buffer;
+	_row_generation = src._row_generation;
+	_generation = src._generation;
+	_blank = src._blank;
 
 	return *this;
 }
@@ -103,6 +582,9 @@ void ScreenBuffer::set_size(Size new_size)
 
 	if(preserve_content)
 	{
+		// pending clears must be applied before the content is moved around
+		materialize();
+
 		const bool initial = _width == 0 and _height == 0;
 
 		if(g_log) fmt::print(g_log, "resize: {}x{} -> {}x{}\n", _width, _height, new_width, new_height);
@@ -133,10 +615,10 @@ void ScreenBuffer::set_size(Size new_size)
 			_buffer.resize(new_height*new_width);
 			resized = true;
 
-			auto row_iter = _buffer.begin() + int(_height*_width);
-			for (auto y = _height; y < new_height; ++y, std::advance(row_iter, _width))
+			auto row_iter = _buffer.begin() + int(_height*new_width);
+			for (auto y = _height; y < new_height; ++y, std::advance(row_iter, new_width))
 			{
-				for(auto iter = row_iter; iter != row_iter + int(_width); ++iter)
+				for(auto iter = row_iter; iter != row_iter + int(new_width); ++iter)
 				{
 					auto &cell = *iter;
 
@@ -157,6 +639,21 @@ void ScreenBuffer::set_size(Size new_size)
 
 	_width = new_width;
 	_height = new_height;
+
+	// all cells are up-to-date at this point
+	_row_generation.assign(_height, _generation);
+}
+
+void ScreenBuffer::materialize_row(std::size_t y)
+{
+	std::fill_n(_buffer.begin() + int(y*_width), _width, _blank);
+	_row_generation[y] = _generation;
+}
+
+void ScreenBuffer::materialize()
+{
+	for(auto y = 0u; y < _height; ++y)
+		touch_row(y);
 }
 
 
@@ -3,20 +3,17 @@
 #include <termic/text.h>
 #include <termic/terminal.h>
 
-#include <mk-wcwidth.h>
-
 #include <string_view>
 using namespace std::literals;
 #include <algorithm>
 #include <chrono>
+#include <utility>
 #include <fmt/format.h>
 using namespace fmt::literals;
 
 #include <sys/ioctl.h>
 #include <assert.h>
 
-static const std::size_t g_tab_width { 8 };
-
 
 namespace termic
 {
@@ -57,6 +54,19 @@ Screen::Screen(int fd) :
 	_output_buffer.append(fmt::format(esc::cup, 1, 1)); // go to origin (b/c default _cursor.pos = 0,0)
 }
 
+Region Screen::region(Rectangle rect)
+{
+	play();
+	_dirty = true;
+
+	return Region(_back_buffer, rect);
+}
+
+Region Screen::region(const Geometry &geometry)
+{
+	return region(geometry.resolve(size()));
+}
+
 void Screen::invalidate()
 {
 	_dirty = true;
@@ -68,6 +78,7 @@ std::size_t Screen::print(Alignment align, Pos anchor_pos, std::string_view s, L
 
 	if(align != Left)
 	{
+		// usually remembered from the previous frame, so only printing decodes 's'
 		const auto text_width = measure(s);
 
 		if(align == Right)
@@ -98,13 +109,13 @@ std::size_t Screen::print(Pos pos, std::size_t wrap_width, std::string_view s, L
 	if(pos.x + wrap_width >= width)
 	    wrap_width = width - pos.x;
 
-	const auto lines = text::wrap(s, wrap_width);
-
 	auto start_y = pos.y;
 
-	for(const auto &line: lines)
+	for(const auto &line: _layout_cache.wrap(s, wrap_width))
 	{
-		print(pos, line, lk);
+		print(pos, s.substr(line.start, line.end - line.start), lk);
+		if(line.hyphen)
+			print(_client_cursor, "-", lk);
 		pos.y = _client_cursor.y + 1;
 		if(pos.y >= height)
 			break;
@@ -115,88 +126,51 @@ std::size_t Screen::print(Pos pos, std::size_t wrap_width, std::string_view s, L
 
 std::size_t Screen::print(Pos pos, std::string_view s, Look lk)
 {
-	const auto &[width, height] = size();
+	_dirty = true;
 
-	if(pos.y >= height)
+	if(_recording)
 	{
-		if(g_log) fmt::print(g_log, "print: off-screen: y  ({})\n", pos.y);
-		return 0;
+		_draw_list.print(pos, s, lk);
+		return _back_buffer.dry_print(rect(), pos, s, {}, &_client_cursor);
 	}
-	go_to(pos);
 
-	auto cx = pos.x;
+	return _back_buffer.print(pos, s, lk, &_client_cursor);
+}
 
+void Screen::blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos)
+{
+	play();
+	_back_buffer.blit(src, src_rect, dst_pos);
 	_dirty = true;
+}
 
-	auto max_width { 0ul };
-	auto curr_width { 0ul };
-
-	auto s_end = utf8::end(s);
-	for(auto iter = utf8::begin(s); iter != s_end; ++iter)
-	{
-		if(iter->codepoint == '\n')
-		{
-			max_width = std::max(max_width, curr_width);
-			curr_width = 0;
-			cx = pos.x;
-			++pos.y;
-			if(pos.y >= height)
-				break;
-			go_to(pos);
-			continue;
-		}
-		if(iter->codepoint == '\t')  // jump to next tab stop
-		{
-			const auto tab_skip = ((cx / g_tab_width) + 1) * g_tab_width - cx;
-			curr_width += tab_skip;
-			cx = pos.x + curr_width;
-			go_to(pos);
-			continue;
-		}
-		if(iter->codepoint == '\v')  // vertical tab (next line w/o carriage return)
-		{
-			++pos.y;
-			if(pos.y >= height)
-				break;
-			go_to({ pos.x, pos.y });
-			continue;
-		}
-
-		if(cx >= width)
-		{
-			if(g_log) fmt::print(g_log, "print: off-screen: x  ({})\n", cx);
-			break;
-		}
-
-		const auto chwidth = static_cast<std::size_t>(std::max(0, ::mk_width(iter->codepoint)));
-
-
-		_back_buffer.set_cell({ cx, pos.y }, iter->sequence, chwidth, lk);
-
-		if(chwidth == 2 and cx < width - 1)
-		{
-			static const auto space { " "sv };
-			// set right-neighbour of double width cell to zero width
-			_back_buffer.set_cell({ cx + 1, pos.y }, space, 0, lk);
-		}
-
-		curr_width += chwidth;
-
-		cx += static_cast<std::size_t>(chwidth);
-
-//		if(g_log) fmt::print(g_log, "{} width: {} -> cx: {}\n", iter->index, chwidth, cx);
-	}
-
-	_client_cursor.x += curr_width;
+void Screen::blit(const ScreenBuffer &src, Rectangle src_rect, Pos dst_pos, float opacity)
+{
+	play();
+	_back_buffer.blit(src, src_rect, dst_pos, opacity);
+	_dirty = true;
+}
 
-	max_width = std::max(max_width, curr_width);
+void Screen::blit(const TiledBuffer &src, Rectangle src_rect, Pos dst_pos)
+{
+	play();
+	src.blit(_back_buffer, src_rect, dst_pos);
+	_dirty = true;
+}
 
-	return max_width;
+void Screen::draw(PixelCanvas &src, Pos dst_pos)
+{
+	play();
+	src.draw(_back_buffer, dst_pos);
+	_dirty = true;
 }
 
 void Screen::clear(Color bg, Color fg)
 {
-	_back_buffer.clear(bg, fg);
+	if(_recording)
+		_draw_list.clear(rect(), bg, fg);
+	else
+		_back_buffer.clear(bg, fg);
 	_dirty = true;
 
 	cursor_move({ 0, 0 });
@@ -204,7 +178,10 @@ void Screen::clear(Color bg, Color fg)
 
 void Screen::clear(const Rectangle &rect, Color bg, Color fg)
 {
-	_back_buffer.clear(rect, bg, fg);
+	if(_recording)
+		_draw_list.clear(rect, bg, fg);
+	else
+		_back_buffer.clear(rect, bg, fg);
 	_dirty = true;
 
 	cursor_move({ 0, 0 });
@@ -221,35 +198,134 @@ void Screen::set_size(Size size)
 
 	_output_buffer.reserve(std::max(150ul, size.width)*std::max(100ul, size.height)*8);  // an over-estimate in an attempt to avoid re-allocation
 
+	play();
+
 	_back_buffer.set_size(size);
 	_front_buffer.set_size(size);
+	_composed_buffer.set_size(size);
+	_composed_stale = true;
 
 	if(size.width < curr_size.width)
 		_front_buffer.clear(color::Default, color::Default, true);
 }
 
+Layer &Screen::add_layer(Rectangle rect, int z)
+{
+	auto iter = std::upper_bound(_layers.begin(), _layers.end(), z, [](int z, const auto &layer) { return z < layer->z(); });
+
+	return **_layers.insert(iter, std::unique_ptr<Layer>(new Layer(rect, z)));
+}
+
+void Screen::remove_layer(const Layer &layer)
+{
+	auto iter = std::find_if(_layers.begin(), _layers.end(), [&layer](const auto &l) { return l.get() == &layer; });
+	if(iter == _layers.end())
+		return;
+
+	if(layer.visible())
+		_exposed = _exposed.united(layer.rect());
+	_exposed = _exposed.united(layer._exposed);
+
+	_layers.erase(iter);
+}
+
+Rectangle Screen::compose()
+{
+	// the rows that changed since the last update
+	auto damaged = _dirty? rect(): _exposed;
+
+	for(auto &layer: _layers)
+	{
+		damaged = damaged.united(layer->screen_damage());
+		layer->_damage = {};
+		layer->_exposed = {};
+	}
+	_exposed = {};
+
+	if(_layers.empty())
+		_composed_stale = true;
+	else if(_composed_stale)
+	{
+		damaged = rect();
+		_composed_stale = false;
+	}
+
+	damaged = damaged.intersected(rect());
+	if(damaged.area() == 0)
+		return damaged;
+
+	if(not _layers.empty())
+	{
+		// one more column on either side, for the other halves of double-width characters at the edges
+		const auto left = damaged.top_left.x > 0? damaged.top_left.x - 1: 0;
+		const auto right = std::min(damaged.top_left.x + damaged.size.width + 1, size().width);
+		const Rectangle area { { left, damaged.top_left.y }, { right - left, damaged.size.height } };
+
+		for(auto y = area.top_left.y; y <= area.bottom(); ++y)
+		{
+			auto dst = _composed_buffer.span({ area.top_left.x, y }, area.size.width);
+			for(std::size_t x = 0; x < dst.size(); ++x)
+				dst[x] = std::as_const(_back_buffer).cell({ area.top_left.x + x, y });
+		}
+
+		for(const auto &layer: _layers)
+		{
+			if(layer->visible())
+				layer->composite(_composed_buffer, area);
+		}
+
+		// layers may have split double-width characters anywhere (of the content, or of a lower layer)
+		for(auto y = area.top_left.y; y <= area.bottom(); ++y)
+			_composed_buffer.fix_wide_cells({ area.top_left.x, y }, area.size.width);
+	}
+
+	// the output is compared row by row
+	return { { 0, damaged.top_left.y }, { size().width, damaged.size.height } };
+}
+
+void Screen::set_recording(bool on)
+{
+	if(not on)
+		play();
+
+	_recording = on;
+}
+
+void Screen::play()
+{
+	_draw_list.play(_back_buffer);
+}
+
 void Screen::update()
 {
-	if(not _dirty)
+	play();
+
+	const auto rows = compose();
+
+	if(rows.area() == 0)
 		return;
 
 	const auto t0 = std::chrono::high_resolution_clock::now();
 
-	// compare '_back_buffer' and '_front_buffer',
-	//   write the difference to the output buffer (such that '_front_buffer' becomes identical to '_back_buffer')
+	// compare the back buffer (or the composition of it and the layers) and '_front_buffer',
+	//   write the difference to the output buffer (such that '_front_buffer' becomes identical to the output)
 
 	const auto size = _back_buffer.size();
 
 	const auto start_pos { _cursor.position };
 
+	// read-only access; rows that were cleared but not written to since then are not materialized
+	const auto &back_buffer = _layers.empty()? _back_buffer: _composed_buffer;
+	const auto &front_buffer = _front_buffer;
+
 	auto num_updated { 0u };
 
-	for(std::size_t cy = 0; cy < size.height; ++cy)
+	for(std::size_t cy = rows.top_left.y; cy <= rows.bottom(); ++cy)
 	{
 		for(std::size_t cx = 0; cx < size.width;)
 		{
-			auto &back_cell = _back_buffer.cell({ cx, cy });
-			auto &front_cell = _front_buffer.cell({ cx, cy });
+			auto &back_cell = back_buffer.cell({ cx, cy });
+			auto &front_cell = front_buffer.cell({ cx, cy });
 
 			if(back_cell != front_cell)
 			{
@@ -287,8 +363,11 @@ void Screen::update()
 
 	if(num_updated > 0)
 	{
-		// the terminal content is now in synch with back buffer, we can copy back -> front
-		_front_buffer = _back_buffer;
+		// the terminal content is now in synch with the output, we can copy output -> front
+		if(rows.size.height == size.height)
+			_front_buffer = back_buffer;
+		else
+			_front_buffer.blit(back_buffer, rows, rows.top_left);
 
 //		if(g_log) fmt::print(g_log, "updated cells: {}\n", num_updated);
 		const auto t1 = std::chrono::high_resolution_clock::now();
@@ -305,13 +384,7 @@ Size Screen::get_terminal_size()
 
 std::size_t Screen::measure(std::string_view s) const
 {
-	std::size_t width { 0 };
-
-	const auto s_end = utf8::end(s);
-	for(auto iter = utf8::begin(s); iter != s_end; ++iter)
-		width += static_cast<std::size_t>(std::max(0, ::mk_width(iter->codepoint)));
-
-	return width;
+	return _width_cache.width(s);
 }
 
 Cell Screen::pick(Pos pos) const
@@ -319,6 +392,11 @@ Cell Screen::pick(Pos pos) const
 	return cell(pos);
 }
 
+Cell Screen::shown(Pos pos) const
+{
+	return _front_buffer.cell(pos);
+}
+
 void Screen::_out(const std::string_view text)
 {
 	_output_buffer.append(text);
@@ -425,6 +503,7 @@ void Screen::cursor_set_look(Look lk)
 
 Cell &Screen::cell(Pos pos)
 {
+	play();
 	return _back_buffer.cell({ pos.x, pos.y });
 }
 
@@ -435,6 +514,7 @@ const Cell &Screen::cell(Pos pos) const
 
 void Screen::set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk)
 {
+	play();
 	_back_buffer.set_cell(pos, ch, width, lk);
 }
 
@@ -1,7 +1,13 @@
 #include <termic/text.h>
 #include <termic/utf8.h>
 
-#include <mk-wcwidth.h>
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <optional>
 
 #include <assert.h>
 
@@ -15,212 +21,565 @@ extern std::FILE *g_log;
 namespace text
 {
 
-std::pair<std::string_view, std::size_t> part_upto_width(std::string_view s, std::size_t limit);
+std::size_t width(std::string_view s)
+{
+	std::size_t width { 0 };
 
+	while(not s.empty())
+	{
+		// runs of plain ASCII are one cell per byte  (except the last character, if combining marks might follow)
+		auto run = utf8::ascii_run(s);
+		if(run > 0 and run < s.size() and static_cast<std::uint8_t>(s[run]) >= 0xcc)
+			--run;
+		width += run;
+		s = s.substr(run);
+		if(s.empty())
+			break;
 
-std::vector<std::string> wrap(std::string_view s, std::size_t limit, BreakMode brmode)
+		const auto cluster = utf8::read_cluster(s);
+		width += static_cast<std::size_t>(std::max(0, cluster.width));
+		s = s.substr(cluster.sequence.size());
+	}
+
+	return width;
+}
+
+// line breaking rules (UAX #14) between two characters, with the rule numbers
+namespace line_break
+{
+
+using enum utf8::LineBreak;
+using LB = utf8::LineBreak;
+
+static constexpr std::size_t num_classes { static_cast<std::size_t>(CB) + 1 };
+
+static constexpr bool any_of(LB c, std::initializer_list<LB> classes)
+{
+	for(const auto cl: classes)
+	{
+		if(c == cl)
+			return true;
+	}
+	return false;
+}
+
+// whether 'a' followed directly by 'b' can't be broken
+static constexpr bool prohibited(LB a, LB b)
+{
+	if(b == WJ or a == WJ)                                                      // 11
+		return true;
+	if(a == GL)                                                                 // 12
+		return true;
+	if(b == GL and not any_of(a, { BA, HY }))                                   // 12a
+		return true;
+	if(any_of(b, { CL, CP, EX, IS, SY }))                                       // 13
+		return true;
+	if(a == OP)                                                                 // 14
+		return true;
+	if(a == QU and b == OP)                                                     // 15
+		return true;
+	if(any_of(a, { CL, CP }) and b == NS)                                       // 16
+		return true;
+	if(a == B2 and b == B2)                                                     // 17
+		return true;
+	if(b == QU or a == QU)                                                      // 19
+		return true;
+	if(b == CB or a == CB)                                                      // 20
+		return false;
+	if(any_of(b, { BA, HY, NS }) or a == BB)                                    // 21
+		return true;
+	if(a == SY and b == HL)                                                     // 21b
+		return true;
+	if(b == IN)                                                                 // 22
+		return true;
+	if((any_of(a, { AL, HL }) and b == NU) or (a == NU and any_of(b, { AL, HL })))  // 23
+		return true;
+	if((a == PR and any_of(b, { ID, EB, EM })) or (any_of(a, { ID, EB, EM }) and b == PO))  // 23a
+		return true;
+	if((any_of(a, { PR, PO }) and any_of(b, { AL, HL })) or (any_of(a, { AL, HL }) and any_of(b, { PR, PO })))  // 24
+		return true;
+	if((any_of(a, { CL, CP, NU }) and any_of(b, { PO, PR }))                    // 25
+	   or (any_of(a, { PO, PR }) and any_of(b, { OP, NU }))
+	   or (any_of(a, { HY, IS, NU, SY }) and b == NU))
+		return true;
+	if((a == JL and any_of(b, { JL, JV, H2, H3 }))                              // 26
+	   or (any_of(a, { JV, H2 }) and any_of(b, { JV, JT }))
+	   or (any_of(a, { JT, H3 }) and b == JT))
+		return true;
+	if((any_of(a, { JL, JV, JT, H2, H3 }) and b == PO) or (a == PR and any_of(b, { JL, JV, JT, H2, H3 })))  // 27
+		return true;
+	if(any_of(a, { AL, HL }) and any_of(b, { AL, HL }))                         // 28
+		return true;
+	if(a == IS and any_of(b, { AL, HL }))                                       // 29
+		return true;
+	if((any_of(a, { AL, HL, NU }) and b == OP) or (a == CP and any_of(b, { AL, HL, NU })))  // 30
+		return true;
+	if(a == RI and b == RI)                                                     // 30a (pairs are counted by LineBreaker)
+		return true;
+	if(a == EB and b == EM)                                                     // 30b
+		return true;
+
+	return false;                                                               // 31
+}
+
+// whether 'a' followed by spaces, then 'b', can't be broken (before 'b'; never between the spaces)
+static constexpr bool prohibited_after_spaces(LB a, LB b)
+{
+	return any_of(b, { WJ, CL, CP, EX, IS, SY })  // 11, 13
+		or a == OP                                // 14
+		or (a == QU and b == OP)                  // 15
+		or (any_of(a, { CL, CP }) and b == NS)    // 16
+		or (a == B2 and b == B2);                 // 17
+}
+
+enum Action : std::uint8_t
+{
+	Direct,      // break allowed
+	Indirect,    // break allowed only if there are spaces between
+	Prohibited,  // no break, even with spaces between
+};
+
+static constexpr auto pairs = []() {
+	std::array<std::array<Action, num_classes>, num_classes> table {};
+
+	for(std::size_t a = 0; a < num_classes; ++a)
+	{
+		for(std::size_t b = 0; b < num_classes; ++b)
+		{
+			const auto ca = static_cast<LB>(a);
+			const auto cb = static_cast<LB>(b);
+			table[a][b] = not prohibited(ca, cb)? Direct: prohibited_after_spaces(ca, cb)? Prohibited: Indirect;
+		}
+	}
+	return table;
+}();
+
+// AI, CJ & SA depend on the break mode (LB1)
+static inline LB resolved(LB c, BreakMode brmode)
 {
-//	if(g_log) fmt::print(g_log, "wrapping '{}'  inside: {}\n", s, limit);
+	switch(c)
+	{
+	case AI: return brmode == EastAsianBreaks? ID: AL;
+	case CJ: return brmode == EastAsianBreaks? ID: NS;
+	case SA: return brmode == SouthEastAsianBreaks? ID: AL;
+	default: return c;
+	}
+}
+
+} // NS: line_break
 
+LineBreaker::Break LineBreaker::next(char32_t codepoint)
+{
+	using enum utf8::LineBreak;
+
+	auto cls = line_break::resolved(utf8::line_break(codepoint), _brmode);
+
+	Break brk { Allowed };
+
+	if(_start)                                                         // 2
+		brk = NoBreak;
+	else if(_before == BK or _before == LF or _before == NL or (_before == CR and cls != LF))  // 4, 5
+		brk = Mandatory;
+	else if(cls == BK or cls == CR or cls == LF or cls == NL or cls == SP or cls == ZW)  // 6, 7
+		brk = NoBreak;
+	else if(_before == ZW)                                             // 8
+		brk = Allowed;
+	else if(_after_zwj)                                                // 8a
+		brk = NoBreak;
+	else if((cls == CM or cls == ZWJ) and not _spaces)                 // 9: attached to the previous character
+	{
+		_after_zwj = cls == ZWJ;
+		return NoBreak;
+	}
+	else
+	{
+		const auto b = (cls == CM or cls == ZWJ)? AL: cls;            // 10
+
+		if(_hebrew_hyphen and not _spaces)                             // 21a
+			brk = NoBreak;
+		else if(_before == RI and b == RI and not _spaces)             // 30a
+			brk = _regional_indicators % 2 == 1? NoBreak: Allowed;
+		else
+		{
+			const auto action = line_break::pairs[static_cast<std::size_t>(_before)][static_cast<std::size_t>(b)];
+			brk = (action == line_break::Direct or (action == line_break::Indirect and _spaces))? Allowed: NoBreak;
+		}
+	}
+
+	if(cls == SP)
+	{
+		_spaces = true;
+		_after_zwj = false;
+		return brk;
+	}
+
+	const auto b = (cls == CM or cls == ZWJ)? AL: cls;
+
+	_hebrew_hyphen = not _start and not _spaces and _before == HL and (b == HY or b == BA);
+	_regional_indicators = b != RI? 0: (not _start and not _spaces and _before == RI and brk == NoBreak)? _regional_indicators + 1: 1;
+	_after_zwj = cls == ZWJ;
+	_before = b;
+	_spaces = false;
+	_start = false;
+
+	return brk;
+}
+
+std::vector<std::string> wrap(std::string_view s, std::size_t limit, BreakMode brmode)
+{
 	if(limit <= 2)  // simply too narrow; nothing useful can come of this
 		return { "…" };
 
-	auto words = text::words(s, [](char32_t ch) -> int { return ::mk_width(ch); }, brmode);
+	std::vector<std::string> wrapped;
+
+	for(const auto &line: lines(s, limit, brmode))
+	{
+		wrapped.emplace_back(s.substr(line.start, line.end - line.start));
+		if(line.hyphen)
+			wrapped.back() += '-';
+	}
+
+	return wrapped;
+}
+
+LayoutCache::LayoutCache(std::size_t max_bytes) :
+	_max_bytes(max_bytes)
+{
+}
+
+std::span<const Line> LayoutCache::wrap(std::string_view s, std::size_t limit, BreakMode brmode)
+{
+	limit = std::max(1ul, limit);
+
+	if(s.size() > std::numeric_limits<std::uint32_t>::max())
+	{
+		_uncached.clear();
+		for(const auto &line: lines(s, limit, brmode))
+			_uncached.push_back(line);
+		return _uncached;
+	}
+
+	auto found = _index.find(s);
+	if(found != _index.end() and found->second->brmode != brmode)
+	{
+		_bytes -= found->second->bytes();
+		_paragraphs.erase(found->second);
+		_index.erase(found);
+		found = _index.end();
+	}
+
+	if(found != _index.end())
+		_paragraphs.splice(_paragraphs.begin(), _paragraphs, found->second);
+	else
+	{
+		auto &p = _paragraphs.emplace_front();
+		p.text = s;
+		p.brmode = brmode;
+		segment(p);
+		_index.emplace(p.text, _paragraphs.begin());
+		_bytes += p.bytes();
+	}
+
+	auto &p = _paragraphs.front();
+	if(p.limit != limit)
+	{
+		_bytes -= p.bytes();
+		break_lines(p, limit);
+		_bytes += p.bytes();
+	}
+
+	evict();
 
+	return p.lines;
+}
+
+void LayoutCache::clear()
+{
+	_index.clear();
+	_paragraphs.clear();
+	_bytes = 0;
+}
+
+std::size_t LayoutCache::Paragraph::bytes() const
+{
+	return sizeof(Paragraph) + text.capacity() + segments.capacity()*sizeof(Segment) + lines.capacity()*sizeof(Line);
+}
+
+std::size_t WidthCache::width(std::string_view s)
+{
+	if(utf8::ascii_run(s) == s.size() or s.size() > max_length)
+		return text::width(s);
+
+	if(_entries.empty())
+		_entries.resize(num_entries);
+
+	const auto hash = std::hash<std::string_view>{}(s);
+	auto &entry = _entries[hash % num_entries];
+	if(entry.hash != hash or entry.text != s)
+	{
+		entry.hash = hash;
+		entry.text.assign(s);
+		entry.width = text::width(s);
+	}
+	else
+		++_hits;
+
+	return entry.width;
+}
+
+void WidthCache::clear()
+{
+	_entries.clear();
+}
+
+void LayoutCache::evict()
+{
+	// the most recently used is always kept (it's what was asked for)
+	while(_bytes > _max_bytes and _paragraphs.size() > 1)
+	{
+		auto &p = _paragraphs.back();
+		_bytes -= p.bytes();
+		_index.erase(p.text);
+		_paragraphs.pop_back();
+	}
+}
 
-	// TODO: there MUST be a simpler way to do this!?
+// the only time the text is decoded; the break opportunities are the same as Lines'
+void LayoutCache::segment(Paragraph &p)
+{
+	const std::string_view s { p.text };
+	auto &segments = p.segments;
 
+	LineBreaker breaker { p.brmode };
 
-	std::vector<std::string> lines;
-	lines.reserve(10);
+	Segment word {};
+	bool in_word { false };
+	bool line_has_word { false };
+	std::uint32_t spaces { 0 };  // since the end of 'word'
 
-	std::string line;
-	line.reserve(limit*2);  // an upper limit-guess
-	std::size_t line_width { 0 };
-	// wrap 's' into lines, maximum 'width' wide,  https://unicode.org/reports/tr14
-	std::size_t word_idx { 0 };
+	auto end_word = [&]() {
+		if(in_word)
+		{
+			word.space_after = spaces;
+			segments.push_back(word);
+			in_word = false;
+			line_has_word = true;
+		}
+		spaces = 0;
+	};
 
-	for(auto word: words)
+	for(std::size_t offset = 0; offset < s.size(); )
 	{
-		const auto &[ws, we, ww, hyphen] = word;
-		const auto wl = we - ws;
+		const auto pos = static_cast<std::uint32_t>(offset);
+		const auto [cp, seq] = utf8::read_valid(s.substr(offset));
+		offset += seq.size();
 
-		if(line_width + ww <= limit)  // word fits current line
+		if(is_line_end(cp))
 		{
-			line += s.substr(ws, wl);
-			line_width += word.width;
-			if(line_width < limit and not hyphen)
-			{
-				line += ' ';
-				++line_width;
-			}
-//			if(g_log) fmt::print(g_log, "[{}] word {} fit on current line -> {}\n", lines.size(), word_idx, line_width);
+			end_word();
+			if(not line_has_word)  // an empty line
+				segments.push_back({ pos, pos, 0, 0, false });
+			segments.back().newline_after = true;
+			line_has_word = false;
+
+			if(cp == '\r' and offset < s.size() and s[offset] == '\n')
+				++offset;
+			breaker.reset();
+			continue;
 		}
-		else if(ww <= limit) // word doesn't fit on current line but will fit next line (next loop)
+
+		if(breaker.next(cp) == LineBreaker::Allowed)
+			end_word();
+
+		const auto width = static_cast<std::uint32_t>(std::max(0, utf8::width(cp)));
+
+		if(utf8::is_brk_space(cp))
 		{
-			// just push this line
-			lines.push_back(line);
-			line.clear();
-			line += s.substr(word.start, word.end - word.start);
-			line_width = word.width;
-			if(line_width < limit and not hyphen)
-			{
-				line += ' ';
-				++line_width;
-			}
-//			if(g_log) fmt::print(g_log, "[{}] word {} fit on a new line -> {}\n", lines.size(), word_idx, line_width);
+			if(in_word)
+				spaces += width;
+			else if(line_has_word)  // spaces at the start of a line are skipped
+				segments.back().space_after += width;
+			continue;
 		}
-		else
+
+		if(not in_word)
 		{
-			if(word.width > limit)  // word doesn't fit on a whole line, we must cut it
+			word = { pos, pos, 0, 0, false };
+			in_word = true;
+		}
+		word.width += spaces + width;
+		spaces = 0;
+		word.end = static_cast<std::uint32_t>(offset);
+	}
+	end_word();
+
+	if(not line_has_word)  // the last line is empty
+	{
+		const auto pos = static_cast<std::uint32_t>(s.size());
+		segments.push_back({ pos, pos, 0, 0, false });
+	}
+
+	segments.shrink_to_fit();
+}
+
+// same result as Lines, but only words that must be cut are decoded
+void LayoutCache::break_lines(Paragraph &p, std::size_t limit)
+{
+	const std::string_view s { p.text };
+	const auto &segments = p.segments;
+
+	p.limit = limit;
+	p.lines.clear();
+
+	// the rest of a word that was cut
+	std::optional<Segment> rest;
+
+	for(std::size_t idx = 0; idx < segments.size(); )
+	{
+		Line line { rest? rest->start: segments[idx].start, 0, 0, false };
+		line.end = line.start;
+		std::size_t width { 0 };
+
+		for(bool first = true; idx < segments.size(); first = false)
+		{
+			auto seg = first and rest? *rest: segments[idx];
+
+			if(width + seg.width > limit)
 			{
-//				if(g_log) fmt::print(g_log, "[{}] word {} doesn't fit current or new, width {} > {}\n", lines.size(), word_idx, word.width, limit - line_width);
+				if(not first)
+					break;
+
+				// the first word doesn't fit; cut it after the last character that fits, leaving room for a hyphen
+				auto hyphen { limit >= 3 };
+				const auto max_width = limit - (hyphen? 1: 0);
 
-				while(word.width > 0)
+				auto cut = std::size_t(seg.start);
+				std::uint32_t cut_width { 0 };
+				std::uint32_t width_so_far { 0 };
+				for(auto offset = cut; offset < seg.end; )
 				{
-					const auto line_remainder { limit - line_width };
-					if(line_remainder > 2)
+					const auto [cp, seq] = utf8::read_valid(s.substr(offset, seg.end - offset));
+					const auto w = static_cast<std::uint32_t>(std::max(0, utf8::width(cp)));
+					if(width_so_far + w > max_width)
+						break;
+					width_so_far += w;
+					offset += seq.size();
+					if(not utf8::is_brk_space(cp))
 					{
-						const auto use_hyphen { word.width > line_remainder };
-
-						const auto upto_width { line_remainder - (use_hyphen? 1: 0) };
-//						if(g_log) fmt::print(g_log, "[{}]     line rem: {}  use hyphen: {}  upto width: {}\n", lines.size(), line_remainder, use_hyphen, upto_width);
-						const auto &[part, part_width] = part_upto_width(s.substr(word.start, word.end - word.start), upto_width);
-						word.width -= part_width;
-						word.start += part.size();
-
-						line += part;
-
-						line_width += part_width;
-						if(use_hyphen)
-						{
-							line += '-';
-							++line_width;
-						}
-//						if(g_log) fmt::print(g_log, "[{}] {}-part word {} fit on current -> {} {}\n", lines.size(), part_width, word_idx, limit - line_width, use_hyphen?"hyphen":"");
+						cut = offset;
+						cut_width = width_so_far;
 					}
+				}
+				if(cut == seg.start)  // not even one character fits; take it anyway
+				{
+					const auto [cp, seq] = utf8::read_valid(s.substr(cut, seg.end - cut));
+					cut += seq.size();
+					cut_width = static_cast<std::uint32_t>(std::max(0, utf8::width(cp)));
+					hyphen = false;
+				}
 
-					assert(not line.empty());
-					lines.push_back(line);
-					line_width = 0;
-					line.clear();
+				if(cut < seg.end)
+				{
+					line.end = cut;
+					line.width = cut_width + (hyphen? 1: 0);
+					line.hyphen = hyphen;
+
+					// the rest starts after any spaces
+					while(cut < seg.end)
+					{
+						const auto [cp, seq] = utf8::read_valid(s.substr(cut, seg.end - cut));
+						if(not utf8::is_brk_space(cp))
+							break;
+						cut += seq.size();
+						cut_width += static_cast<std::uint32_t>(std::max(0, utf8::width(cp)));
+					}
+					seg.width -= cut_width;
+					seg.start = static_cast<std::uint32_t>(cut);
+					rest = seg;
+					break;
 				}
+				// it was only a single (too wide) character
 			}
-			else
-			{
-				lines.push_back(line);
-				line = s.substr(word.start, word.end - word.start);
-				line_width = word.width;
-//				if(g_log) fmt::print(g_log, "[{}] word {} fits on the next line -> {}\n", lines.size(), word_idx, line_width);
-			}
-		}
-		++word_idx;
-	}
-	if(not line.empty())
-		lines.push_back(line);
 
-	return lines;
-};
+			if(first)
+				rest.reset();
 
-std::pair<std::string_view, std::size_t> part_upto_width(std::string_view s, std::size_t limit)
-{
-	std::size_t width { 0 };
+			width += seg.width;
+			line.end = seg.end;
+			line.width = width;
+			++idx;
 
-	std::size_t end_index { 0 };
-	const auto s_end = utf8::end(s);
+			if(seg.newline_after)
+				break;
 
-	for(auto iter = utf8::begin(s); iter != s_end and width < limit; ++iter)
-	{
-		const auto w = static_cast<std::size_t>(::mk_width(iter->codepoint));
-		if(width + w > limit)
-			break;
-		width += w;
-		end_index = iter->byte_offset + iter->sequence.size();
+			width += seg.space_after;
+		}
+
+		p.lines.push_back(line);
 	}
-	return { s.substr(0, end_index), width };
-};
+}
 
 
 std::vector<Word> words(std::string_view s, std::function<int(char32_t)> char_width, BreakMode brmode)
 {
 	std::vector<Word> words;
-	words.reserve(std::max(5ul, s.size() / 5));  // a stab in the dark
 
-	auto s2 = s;
+	LineBreaker breaker { brmode };
 
-	auto s_end = utf8::end(s);
+	Word word;
+	bool in_word { false };
+	std::size_t spaces { 0 };  // since the end of 'word'
 
-	auto iter = utf8::begin(s);
-	// skip initial spaces
-	while(iter != s_end and utf8::is_space(iter->codepoint))
-		s2 = s2.substr(iter->sequence.size());
+	auto end_word = [&]() {
+		if(in_word)
+			words.push_back(word);
+		in_word = false;
+		spaces = 0;
+	};
 
-	if(s2.size() < s.size())
-		if(g_log) fmt::print(g_log, "skipped {} initial space\n", s.size() - s2.size());
-
-	s = s2;
-
-	if(s.empty())
-		return {};
-
-	iter = utf8::begin(s);
-	s_end = utf8::end(s);
-
-	Word curr_word;
-
-	// collect locations to break at (e.g. whitespace) in 's'
-	while(iter != s_end)
+	for(std::size_t offset = 0; offset < s.size(); )
 	{
-		const auto cp = iter->codepoint;
-		const bool is_space = utf8::is_brk_space(cp);
+		const auto pos = offset;
+		const auto [cp, seq] = utf8::read_valid(s.substr(offset));
+		offset += seq.size();
 
-		if(is_space or (brmode == WesternBreaks and cp == '-')) // TODO: does unicode have several hyphen characters?
+		if(is_line_end(cp))
 		{
-			if(cp == '-')  // include the hyphen in the word
-			{
-				++curr_word.width;
-				++iter;
-			}
+			end_word();
+			breaker.reset();
+			continue;
+		}
 
-			words.push_back({
-			    .start = curr_word.start,
-			    .end = iter->byte_offset,
-				.width = curr_word.width,
-				.hyphenated = cp == '-',
-			});
+		if(breaker.next(cp) == LineBreaker::Allowed)
+			end_word();
 
-			if(is_space)
-			{
-				// skip all consecutive spaces
-				while(++iter != s_end and utf8::is_space(iter->codepoint))
-					;
-			}
+		const auto width = char_width? static_cast<std::size_t>(std::max(0, char_width(cp))): 0;
 
-			curr_word.start = iter->byte_offset;
-			curr_word.width = 0;
-		}
-		else
+		if(utf8::is_brk_space(cp))
 		{
-			if(char_width)
-				curr_word.width += static_cast<std::size_t>(std::max(0, char_width(iter->codepoint)));
-			++iter;
+			if(in_word)
+				spaces += width;
+			continue;
 		}
-	}
 
-	if(words.back().end != s.size())
-	{
-		words.push_back({
-		    .start = curr_word.start,
-		    .end = s.size(),
-		    .width = curr_word.width
-		});
+		if(not in_word)
+		{
+			word = { .start = pos, .end = pos };
+			in_word = true;
+		}
+		word.width += spaces + width;
+		spaces = 0;
+		word.end = offset;
+		word.hyphenated = utf8::line_break(cp) == utf8::LineBreak::HY;
 	}
+	end_word();
 
 	return words;
 }
 
 // TODO: should use something established instead, e.g. https://github.com/DuffsDevice/tiny-utf8
-//   these functions are very slow, they always perform iteration from the beginning of the string
+//   the string_view versions (size(), substr() & find_byte_offset()) always iterate from the beginning of the string;
+//   the utf8::string versions use its index
 
 static std::size_t find_byte_offset(utf8::string_view s, std::size_t at)
 {
@@ -243,19 +602,12 @@ static std::size_t find_byte_offset(utf8::string_view s, std::size_t at)
 
 utf8::string &insert(utf8::string &s, utf8::string_view insert, std::size_t at)
 {
-	auto byte_offset = find_byte_offset(s, at);
-	return s.insert(byte_offset, insert);
+	return s.insert(at, insert);
 }
 
 utf8::string &erase(utf8::string &s, std::size_t start, std::size_t len)
 {
-	if(not len)
-		return s;
-
-	auto start_byte_offset = find_byte_offset(s, start);
-	auto byte_len = find_byte_offset(s.substr(start_byte_offset), len);
-
-	return s.erase(start_byte_offset, byte_len);
+	return s.erase(start, len);
 }
 
 std::size_t size(utf8::string_view s)
@@ -283,6 +635,357 @@ utf8::string_view substr(utf8::string_view s, std::size_t start, std::size_t len
 	return s.substr(start_byte_offset, byte_len);
 }
 
+utf8::string_view substr(const utf8::string &s, std::size_t start, std::size_t len)
+{
+	if(not len)
+		return s;
+
+	return s.substr(start, len);
+}
+
+
+struct Document::Node
+{
+	std::string chunk;
+	std::uint32_t priority;
+	NodePtr left;
+	NodePtr right;
+	std::size_t chunk_newlines;
+	// of the whole subtree
+	std::size_t bytes;
+	std::size_t newlines;
+};
+
+// chunks are at most this large, except when single edits grow them
+static constexpr std::size_t max_chunk { 1024 };
+
+// pseudo-random treap priorities; keeps the tree balanced (on average) regardless of the edit pattern
+static std::uint32_t next_priority()
+{
+	static std::atomic<std::uint32_t> counter { 0 };
+
+	auto h = counter++;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+Document::Document(std::string_view s) :
+	_root(build(s))
+{
+}
+
+std::size_t Document::bytes(const NodePtr &node)
+{
+	return node? node->bytes: 0;
+}
+
+std::size_t Document::newlines(const NodePtr &node)
+{
+	return node? node->newlines: 0;
+}
+
+Document::NodePtr Document::make(std::string_view chunk, std::uint32_t priority, NodePtr left, NodePtr right)
+{
+	const auto chunk_newlines = static_cast<std::size_t>(std::count(chunk.begin(), chunk.end(), '\n'));
+	const auto size = bytes(left) + chunk.size() + bytes(right);
+	const auto lines = newlines(left) + chunk_newlines + newlines(right);
+
+	return std::make_shared<const Node>(Node{
+		.chunk = std::string(chunk),
+		.priority = priority,
+		.left = std::move(left),
+		.right = std::move(right),
+		.chunk_newlines = chunk_newlines,
+		.bytes = size,
+		.newlines = lines,
+	});
+}
+
+Document::NodePtr Document::build(std::string_view s)
+{
+	NodePtr root;
+
+	while(not s.empty())
+	{
+		// don't split UTF-8 sequences
+		auto end = std::min(max_chunk, s.size());
+		while(end < s.size() and end > 0 and (s[end] & 0xc0) == 0x80)
+			--end;
+		if(end == 0)
+			end = std::min(max_chunk, s.size());
+
+		root = merge(root, make(s.substr(0, end), next_priority(), {}, {}));
+		s = s.substr(end);
+	}
+
+	return root;
+}
+
+// [0, offset) and [offset, end)
+std::pair<Document::NodePtr, Document::NodePtr> Document::split(const NodePtr &node, std::size_t offset)
+{
+	if(not node)
+		return {};
+
+	const auto left = bytes(node->left);
+	const auto chunk_end = left + node->chunk.size();
+
+	if(offset <= left)
+	{
+		auto [a, b] = split(node->left, offset);
+		if(not b and offset == left and not node->left)  // nothing to the left
+			return { nullptr, node };
+		return { std::move(a), make(node->chunk, node->priority, std::move(b), node->right) };
+	}
+	if(offset >= chunk_end)
+	{
+		auto [a, b] = split(node->right, offset - chunk_end);
+		if(not b and offset == node->bytes)  // nothing to the right
+			return { node, nullptr };
+		return { make(node->chunk, node->priority, node->left, std::move(a)), std::move(b) };
+	}
+
+	// in the middle of this chunk; both halves keep its priority
+	const std::string_view chunk { node->chunk };
+	const auto at = offset - left;
+	return {
+		make(chunk.substr(0, at), node->priority, node->left, nullptr),
+		make(chunk.substr(at), node->priority, nullptr, node->right),
+	};
+}
+
+Document::NodePtr Document::merge(const NodePtr &a, const NodePtr &b)
+{
+	if(not a)
+		return b;
+	if(not b)
+		return a;
+
+	if(a->priority > b->priority)
+		return make(a->chunk, a->priority, a->left, merge(a->right, b));
+	else
+		return make(b->chunk, b->priority, merge(a, b->left), b->right);
+}
+
+// inserts 's' into the chunk that contains 'offset', if it stays small enough; returns null otherwise
+//   (avoids a new node for each typed character)
+Document::NodePtr Document::insert_into(const NodePtr &node, std::size_t offset, std::string_view s)
+{
+	if(not node)
+		return nullptr;
+
+	const auto left = bytes(node->left);
+
+	if(offset < left)
+	{
+		auto l = insert_into(node->left, offset, s);
+		return l? make(node->chunk, node->priority, std::move(l), node->right): nullptr;
+	}
+	offset -= left;
+
+	if(offset <= node->chunk.size())
+	{
+		if(node->chunk.size() + s.size() > max_chunk)
+			return nullptr;
+
+		auto chunk = node->chunk;
+		chunk.insert(offset, s);
+		return make(chunk, node->priority, node->left, node->right);
+	}
+
+	auto r = insert_into(node->right, offset - node->chunk.size(), s);
+	return r? make(node->chunk, node->priority, node->left, std::move(r)): nullptr;
+}
+
+void Document::insert(std::size_t offset, std::string_view s)
+{
+	if(s.empty())
+		return;
+
+	offset = std::min(offset, size());
+
+	if(auto root = insert_into(_root, offset, s); root)
+	{
+		_root = std::move(root);
+		return;
+	}
+
+	auto [a, b] = split(_root, offset);
+	_root = merge(merge(a, build(s)), b);
+}
+
+void Document::erase(std::size_t offset, std::size_t len)
+{
+	if(offset >= size() or len == 0)
+		return;
+
+	len = std::min(len, size() - offset);
+
+	auto [a, rest] = split(_root, offset);
+	auto [removed, b] = split(rest, len);
+	_root = merge(a, b);
+}
+
+std::size_t Document::line_start(std::size_t line) const
+{
+	if(line == 0)
+		return 0;
+	if(line > newlines(_root))
+		return size();
+
+	// find the 'line'th newline
+	std::size_t offset { 0 };
+	auto *node = _root.get();
+
+	while(node)
+	{
+		const auto left = newlines(node->left);
+		if(line <= left)
+		{
+			node = node->left.get();
+			continue;
+		}
+		offset += bytes(node->left);
+		line -= left;
+
+		if(line <= node->chunk_newlines)
+		{
+			const auto *p = node->chunk.data();
+			for(;; --line)
+			{
+				p = static_cast<const char *>(std::memchr(p, '\n', node->chunk.size() - std::size_t(p - node->chunk.data())));
+				if(line == 1)
+					return offset + std::size_t(p - node->chunk.data()) + 1;
+				++p;
+			}
+		}
+		line -= node->chunk_newlines;
+		offset += node->chunk.size();
+		node = node->right.get();
+	}
+
+	return size();
+}
+
+std::size_t Document::line_of(std::size_t offset) const
+{
+	std::size_t line { 0 };
+	auto *node = _root.get();
+
+	while(node)
+	{
+		const auto left = bytes(node->left);
+		if(offset <= left)
+		{
+			node = node->left.get();
+			continue;
+		}
+		line += newlines(node->left);
+		offset -= left;
+
+		if(offset <= node->chunk.size())
+		{
+			const std::string_view chunk { node->chunk };
+			return line + static_cast<std::size_t>(std::count(chunk.begin(), chunk.begin() + std::ptrdiff_t(offset), '\n'));
+		}
+		line += node->chunk_newlines;
+		offset -= node->chunk.size();
+		node = node->right.get();
+	}
+
+	return line;
+}
+
+// [offset, end) relative to 'node'
+void Document::chunks(const Node *node, std::size_t offset, std::size_t end, const std::function<void (std::string_view)> &f)
+{
+	if(not node or offset >= end)
+		return;
+
+	const auto left = bytes(node->left);
+	const auto chunk_end = left + node->chunk.size();
+
+	if(offset < left)
+		chunks(node->left.get(), offset, std::min(end, left), f);
+
+	if(offset < chunk_end and end > left)
+	{
+		const auto first = std::max(offset, left) - left;
+		const auto last = std::min(end, chunk_end) - left;
+		f(std::string_view(node->chunk).substr(first, last - first));
+	}
+
+	if(end > chunk_end)
+		chunks(node->right.get(), std::max(offset, chunk_end) - chunk_end, end - chunk_end, f);
+}
+
+void Document::chunks(std::size_t offset, std::size_t len, const std::function<void (std::string_view)> &f) const
+{
+	if(offset >= size())
+		return;
+
+	chunks(_root.get(), offset, offset + std::min(len, size() - offset), f);
+}
+
+std::string Document::substr(std::size_t offset, std::size_t len) const
+{
+	std::string s;
+	chunks(offset, len, [&s](std::string_view part) { s += part; });
+	return s;
+}
+
+std::string Document::line(std::size_t line) const
+{
+	const auto start = line_start(line);
+	const auto end = line + 1 < lines()? line_start(line + 1) - 1: size();
+
+	return substr(start, end - start);
+}
+
+std::string Document::str() const
+{
+	return substr(0);
+}
+
+void Document::visual_lines(std::size_t first_line, std::size_t limit, const std::function<bool (std::size_t, std::string_view, bool)> &f, BreakMode brmode) const
+{
+	std::string scratch;
+	auto start = line_start(first_line);
+
+	for(auto line = first_line; line < lines(); ++line)
+	{
+		const auto next = line + 1 < lines()? line_start(line + 1): size() + 1;
+
+		// use the chunk directly, if the line is in one piece
+		std::string_view text;
+		std::size_t pieces { 0 };
+		scratch.clear();
+		chunks(start, next - 1 - start, [&](std::string_view part) {
+			if(pieces++ == 0)
+				text = part;
+			else
+			{
+				if(pieces == 2)
+					scratch = text;
+				scratch += part;
+			}
+		});
+		if(pieces > 1)
+			text = scratch;
+
+		for(const auto &visual: text::lines(text, limit, brmode))
+		{
+			if(not f(line, text.substr(visual.start, visual.end - visual.start), visual.hyphen))
+				return;
+		}
+
+		start = next;
+	}
+}
 
 } // NS: text
 
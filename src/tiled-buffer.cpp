@@ -0,0 +1,103 @@
+#include <termic/tiled-buffer.h>
+#include <termic/screen-buffer.h>
+
+#include <algorithm>
+
+
+namespace termic
+{
+
+TiledBuffer::TiledBuffer(Size size)
+{
+	set_size(size);
+}
+
+void TiledBuffer::set_size(Size size)
+{
+	_width = size.width;
+	_height = size.height;
+	_tiles_x = (_width + tile_width - 1) / tile_width;
+
+	const auto tiles_y = (_height + tile_height - 1) / tile_height;
+
+	_tiles.clear();
+	_tiles.resize(_tiles_x*tiles_y);
+}
+
+void TiledBuffer::clear()
+{
+	for(auto &t: _tiles)
+		t.reset();
+}
+
+Cell &TiledBuffer::writable_cell(Pos pos)
+{
+	auto &t = _tiles[tile_index(pos)];
+	if(not t)
+		t = std::make_unique<Tile>(blank_tile());
+
+	return (*t)[tile_offset(pos)];
+}
+
+void TiledBuffer::set_cell(Pos pos, std::string_view ch, std::size_t width, Look lk)
+{
+	if(pos.x >= _width or pos.y >= _height)
+		return;
+
+	writable_cell(pos).set(ch, width, lk);
+}
+
+void TiledBuffer::blit(ScreenBuffer &dst, Rectangle src_rect, Pos dst_pos) const
+{
+	const auto dst_size = dst.size();
+
+	if(src_rect.top_left.x >= _width or src_rect.top_left.y >= _height or dst_pos.x >= dst_size.width or dst_pos.y >= dst_size.height)
+		return;
+
+	const auto width = std::min({ src_rect.size.width, _width - src_rect.top_left.x, dst_size.width - dst_pos.x });
+	const auto height = std::min({ src_rect.size.height, _height - src_rect.top_left.y, dst_size.height - dst_pos.y });
+
+	if(width == 0)
+		return;
+
+	for(std::size_t row = 0; row < height; ++row)
+	{
+		const Pos dst_row { dst_pos.x, dst_pos.y + row };
+		auto dst_span = dst.span(dst_row, width);
+
+		Pos src { src_rect.top_left.x, src_rect.top_left.y + row };
+		auto dst_iter = dst_span.begin();
+
+		// copy each part of the row that is inside a single tile
+		while(dst_iter != dst_span.end())
+		{
+			const auto count = std::min(tile_width - src.x % tile_width, std::size_t(dst_span.end() - dst_iter));
+			const auto src_iter = tile(src).cbegin() + int(tile_offset(src));
+
+			dst_iter = std::copy(src_iter, src_iter + int(count), dst_iter);
+			src.x += count;
+		}
+
+		dst.fix_wide_edges(dst_row, width);
+	}
+}
+
+std::size_t TiledBuffer::allocated_tiles() const
+{
+	return std::size_t(std::count_if(_tiles.begin(), _tiles.end(), [](const auto &t) { return bool(t); }));
+}
+
+const TiledBuffer::Tile &TiledBuffer::blank_tile()
+{
+	static const Tile blank = [] {
+		Tile t;
+		Cell c {};
+		c.width = 1;
+		t.fill(c);
+		return t;
+	}();
+
+	return blank;
+}
+
+} // NS: termic
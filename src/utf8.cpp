@@ -1,13 +1,18 @@
 #include <termic/utf8.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 namespace termic
 {
 
 namespace utf8
 {
 
-Iterator::Iterator(std::string_view s) :
-	  _s(s)
+Iterator::Iterator(std::string_view s, bool validate) :
+	  _s(s),
+	  _validate(validate)
 {
 	read_next();
 	_current.index = 0;
@@ -24,7 +29,14 @@ void Iterator::read_next()
 		++_current.index;
 		_current.byte_offset = _head_offset;
 
-		auto ch = read_one(_s.substr(_head_offset), &eaten);
+		auto ch = _validate? read_valid(_s.substr(_head_offset)): read_one(_s.substr(_head_offset), &eaten);
+		if(_validate)
+			eaten = ch.second.size();
+		else if(eaten == 0)  // truncated at the end; eat the rest, or we'd never get there
+		{
+			eaten = _s.size() - _head_offset;
+			ch = { replacement, _s.substr(_head_offset) };
+		}
 		_current.codepoint = ch.first;
 		_current.sequence = ch.second;
 
@@ -77,6 +89,349 @@ std::pair<char32_t, std::string_view> read_one(std::string_view s, std::size_t *
 	return { codepoint, s };
 }
 
+// the valid range of the byte following 'lead'  (Unicode table 3-7; excludes overlongs, surrogates & > U+10FFFF)
+static inline std::pair<std::uint8_t, std::uint8_t> second_byte_range(std::uint8_t lead)
+{
+	switch(lead)
+	{
+	case 0xe0: return { 0xa0, 0xbf };
+	case 0xed: return { 0x80, 0x9f };
+	case 0xf0: return { 0x90, 0xbf };
+	case 0xf4: return { 0x80, 0x8f };
+	default:   return { 0x80, 0xbf };
+	}
+}
+
+std::pair<char32_t, std::string_view> read_valid(std::string_view s)
+{
+	if(s.empty())
+		return { 0, {} };
+
+	const auto lead = static_cast<std::uint8_t>(s[0]);
+	if(lead < 0x80)
+		return { lead, s.substr(0, 1) };
+
+	std::size_t len { 0 };
+	if(lead >= 0xc2 and lead <= 0xdf)
+		len = 2;
+	else if(lead >= 0xe0 and lead <= 0xef)
+		len = 3;
+	else if(lead >= 0xf0 and lead <= 0xf4)
+		len = 4;
+	else  // a continuation byte, or can only start an overlong or too large codepoint
+		return { replacement, s.substr(0, 1) };
+
+	char32_t codepoint = lead & initial_mask[len - 1];
+
+	for(auto idx = 1u; idx < len; ++idx)
+	{
+		const auto [low, high] = idx == 1? second_byte_range(lead): std::pair<std::uint8_t, std::uint8_t>{ 0x80, 0xbf };
+
+		if(idx >= s.size() or static_cast<std::uint8_t>(s[idx]) < low or static_cast<std::uint8_t>(s[idx]) > high)
+			return { replacement, s.substr(0, idx) };
+
+		codepoint <<= 6;
+		codepoint |= static_cast<char32_t>(s[idx] & subsequent_mask);
+	}
+
+	return { codepoint, s.substr(0, len) };
+}
+
+// number of ASCII bytes at the start of 's' (up to a multiple of 8), looking at 8 bytes at a time
+static inline std::size_t ascii_words(std::string_view s)
+{
+	constexpr std::uint64_t high_bits { 0x8080808080808080 };
+
+	std::size_t offset { 0 };
+	for(; offset + 8 <= s.size(); offset += 8)
+	{
+		std::uint64_t w;
+		std::memcpy(&w, s.data() + offset, sizeof(w));
+		if(w & high_bits)
+			break;
+	}
+	return offset;
+}
+
+std::u32string decode(std::string_view s)
+{
+	std::u32string codepoints(s.size(), U'\0');  // never more than the bytes
+	std::size_t count { 0 };
+
+	for(std::size_t offset = 0; offset < s.size(); )
+	{
+		const auto ascii = ascii_words(s.substr(offset));
+		for(const auto end = offset + ascii; offset < end; ++offset)
+			codepoints[count++] = static_cast<char32_t>(s[offset]);
+
+		if(offset == s.size())
+			break;
+
+		const auto [codepoint, sequence] = read_valid(s.substr(offset));
+		codepoints[count++] = codepoint;
+		offset += sequence.size();
+	}
+
+	codepoints.resize(count);
+	return codepoints;
+}
+
+bool is_valid(std::string_view s)
+{
+	for(std::size_t offset = 0; offset < s.size(); )
+	{
+		offset += ascii_words(s.substr(offset));
+		if(offset == s.size())
+			break;
+
+		const auto [codepoint, sequence] = read_valid(s.substr(offset));
+		if(codepoint == replacement and sequence != replacement_sequence)
+			return false;
+		offset += sequence.size();
+	}
+
+	return true;
+}
+
+
+// grapheme cluster boundaries (UAX #29) between two characters, with the rule numbers
+namespace grapheme
+{
+
+using enum GraphemeBreak;
+
+static constexpr std::size_t num_properties { static_cast<std::size_t>(ExtendedPictographic) + 1 };
+
+// whether 'b' joins the cluster of 'a', by the rules that only need the pair  (GB11, 12 & 13 need more)
+static constexpr bool joins(GraphemeBreak a, GraphemeBreak b)
+{
+	if(a == CR and b == LF)                                            // 3
+		return true;
+	if(a == Control or a == CR or a == LF)                             // 4
+		return false;
+	if(b == Control or b == CR or b == LF)                             // 5
+		return false;
+	if(a == L and (b == L or b == V or b == LV or b == LVT))           // 6
+		return true;
+	if((a == LV or a == V) and (b == V or b == T))                     // 7
+		return true;
+	if((a == LVT or a == T) and b == T)                                // 8
+		return true;
+	if(b == Extend or b == ZWJ)                                        // 9
+		return true;
+	if(b == SpacingMark)                                               // 9a
+		return true;
+	if(a == Prepend)                                                   // 9b
+		return true;
+
+	return false;                                                      // 999
+}
+
+static constexpr auto pairs = []() {
+	std::array<std::array<bool, num_properties>, num_properties> table {};
+	for(std::size_t a = 0; a < num_properties; ++a)
+	{
+		for(std::size_t b = 0; b < num_properties; ++b)
+			table[a][b] = joins(static_cast<GraphemeBreak>(a), static_cast<GraphemeBreak>(b));
+	}
+	return table;
+}();
+
+} // NS: grapheme
+
+Cluster read_cluster(std::string_view s)
+{
+	using enum GraphemeBreak;
+
+	if(s.empty())
+		return {};
+
+	const auto [first, first_seq] = read_valid(s);
+	std::size_t end = first_seq.size();
+
+	// nothing joins characters below U+0300 (the combining marks), except CR LF
+	const auto next_lead = end < s.size()? static_cast<std::uint8_t>(s[end]): 0;
+	if(first >= 0x20 and first < 0x300 and next_lead < 0xcc)
+		return { first, s.substr(0, end), width(first) };
+
+	Cluster cluster { first, s.substr(0, end), width(first) };
+	if(first == replacement and first_seq != replacement_sequence)
+		return cluster;
+
+	auto before = grapheme_break(first);
+	// the state of the rules that look further back
+	auto pictographic = before == ExtendedPictographic;  // only followed by Extend (so far)
+	auto zwj_after_pictographic { false };
+	std::size_t regional_indicators = before == RegionalIndicator? 1: 0;
+
+	while(end < s.size())
+	{
+		const auto [codepoint, sequence] = read_valid(s.substr(end));
+		if(codepoint == replacement and sequence != replacement_sequence)
+			break;
+
+		const auto gb = grapheme_break(codepoint);
+
+		bool join;
+		if(before == ZWJ and gb == ExtendedPictographic)                   // 11
+			join = zwj_after_pictographic;
+		else if(before == RegionalIndicator and gb == RegionalIndicator)   // 12, 13
+			join = regional_indicators % 2 == 1;
+		else
+			join = grapheme::pairs[static_cast<std::size_t>(before)][static_cast<std::size_t>(gb)];
+		if(not join)
+			break;
+
+		if(codepoint == 0xfe0f and cluster.width == 1 and grapheme_break(cluster.codepoint) == ExtendedPictographic)
+			cluster.width = 2;  // emoji presentation
+		else if(before != ZWJ)
+			cluster.width = std::min(2, cluster.width + std::max(0, width(codepoint)));  // a cell can't be wider
+
+		zwj_after_pictographic = gb == ZWJ and pictographic;
+		pictographic = gb == ExtendedPictographic or (pictographic and gb == Extend);
+		regional_indicators = gb == RegionalIndicator? regional_indicators + 1: 0;
+		before = gb;
+		end += sequence.size();
+	}
+
+	cluster.sequence = s.substr(0, end);
+	return cluster;
+}
+
+
+// offset of the codepoint following the one at 'offset'  (a truncated sequence at the end counts as one)
+static inline std::size_t next_offset(std::string_view s, std::size_t offset)
+{
+	return std::min(s.size(), offset + sequence_length[static_cast<std::uint8_t>(s[offset])]);
+}
+
+string::string(std::string_view s) :
+	_bytes(s)
+{
+	_size = index_range(0, 0, _bytes.size(), _checkpoints);
+}
+
+std::size_t string::index_range(std::size_t index, std::size_t byte_offset, std::size_t end_byte, std::vector<Checkpoint> &out) const
+{
+	std::size_t count { 0 };
+
+	while(byte_offset < end_byte)
+	{
+		byte_offset = next_offset(_bytes, byte_offset);
+		++count;
+
+		if(count % checkpoint_interval == 0 and byte_offset < end_byte)
+			out.push_back({ index + count, byte_offset });
+	}
+
+	return count;
+}
+
+std::vector<string::Checkpoint>::const_iterator string::checkpoint_before(std::size_t at) const
+{
+	auto found = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), at, [](std::size_t idx, const Checkpoint &cp) {
+		return idx < cp.index;
+	});
+	return found - 1;  // the first is { 0, 0 }, so there's always one
+}
+
+std::size_t string::byte_offset(std::size_t at) const
+{
+	if(at >= _size)
+		return _bytes.size();
+
+	const auto cp = checkpoint_before(at);
+
+	auto offset = cp->byte_offset;
+	for(auto idx = cp->index; idx < at; ++idx)
+		offset = next_offset(_bytes, offset);
+
+	return offset;
+}
+
+string &string::insert(std::size_t at, std::string_view s)
+{
+	if(s.empty())
+		return *this;
+
+	at = std::min(at, _size);
+	const auto offset = byte_offset(at);
+
+	_bytes.insert(offset, s);
+
+	std::size_t count { 0 };
+	for(std::size_t idx = 0; idx < s.size(); idx = next_offset(s, idx))
+		++count;
+
+	// everything after the insertion moves along
+	const auto first = checkpoint_before(at) + 1;
+	for(auto cp = _checkpoints.begin() + (first - _checkpoints.cbegin()); cp != _checkpoints.end(); ++cp)
+	{
+		cp->index += count;
+		cp->byte_offset += s.size();
+	}
+	_size += count;
+
+	rebalance(at);
+
+	return *this;
+}
+
+string &string::erase(std::size_t start, std::size_t len)
+{
+	if(start >= _size or len == 0)
+		return *this;
+
+	len = std::min(len, _size - start);
+
+	const auto first_byte = byte_offset(start);
+	const auto end_byte = byte_offset(start + len);
+
+	_bytes.erase(first_byte, end_byte - first_byte);
+
+	// checkpoints inside the erased range are gone, the ones after it move back
+	auto first = _checkpoints.begin() + (checkpoint_before(start) + 1 - _checkpoints.cbegin());
+	auto last = first;
+	while(last != _checkpoints.end() and last->index <= start + len)
+		++last;
+	first = _checkpoints.erase(first, last);
+
+	for(auto cp = first; cp != _checkpoints.end(); ++cp)
+	{
+		cp->index -= len;
+		cp->byte_offset -= end_byte - first_byte;
+	}
+	_size -= len;
+
+	rebalance(start);
+
+	return *this;
+}
+
+std::string_view string::substr(std::size_t start, std::size_t len) const
+{
+	const auto first_byte = byte_offset(start);
+	const auto end_byte = len >= _size? _bytes.size(): byte_offset(start + len);
+
+	return std::string_view(_bytes).substr(first_byte, end_byte - first_byte);
+}
+
+// re-index the gap between checkpoints around 'at', if it has grown too large
+void string::rebalance(std::size_t at)
+{
+	const auto cp = checkpoint_before(at);
+	const auto next = cp + 1;
+
+	const auto gap_end = next == _checkpoints.end()? _size: next->index;
+	if(gap_end - cp->index <= 2*checkpoint_interval)
+		return;
+
+	std::vector<Checkpoint> added;
+	index_range(cp->index, cp->byte_offset, next == _checkpoints.end()? _bytes.size(): next->byte_offset, added);
+
+	_checkpoints.insert(next, added.begin(), added.end());
+}
+
 } // NS: utf8
 
 } // NS: termic
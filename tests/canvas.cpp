@@ -0,0 +1,221 @@
+#include <termic/canvas.h>
+#include <termic/samplers.h>
+#include <termic/screen.h>
+using namespace  termic;
+
+using namespace std::literals;
+
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <numbers>
+#include <span>
+
+
+TEST_CASE("Drawing images", "Canvas::blit_image") {
+	Screen screen(-1);
+	screen.set_size({ 4, 2 });
+	screen.clear();
+
+	// 4x2 pixels: left half red/black stripes, right half blue
+	const std::uint8_t rgb[] {
+		200, 0, 0,   200, 0, 0,   0, 0, 100,   0, 0, 100,
+		  0, 0, 0,     0, 0, 0,   0, 0, 100,   0, 0, 100,
+	};
+
+	Canvas canvas(screen);
+	canvas.blit_image({ { 0, 0 }, { 2, 1 } }, rgb, 4, 2);
+	REQUIRE(screen.pick({ 0, 0 }).look.bg == color::rgb(100, 0, 0));
+	REQUIRE(screen.pick({ 1, 0 }).look.bg == color::rgb(0, 0, 100));
+	REQUIRE(screen.pick({ 2, 0 }).look.bg == color::Default);
+
+	// upscaled, as half blocks, partly off-screen
+	canvas.blit_image({ { 2, 1 }, { 4, 1 } }, rgb, 4, 2, 0, Canvas::HalfBlocks);
+	REQUIRE(screen.pick({ 2, 1 }).ch == "▀"sv);
+	REQUIRE(screen.pick({ 2, 1 }).look.fg == color::rgb(200, 0, 0));
+	REQUIRE(screen.pick({ 2, 1 }).look.bg == color::Black);
+	REQUIRE(screen.pick({ 3, 1 }).look.fg == color::rgb(200, 0, 0));
+
+	REQUIRE(canvas.cached_images() == 2);
+
+	// the same image is taken from the cache, even at another position
+	canvas.blit_image({ { 2, 0 }, { 2, 1 } }, rgb, 4, 2);
+	REQUIRE(canvas.cached_images() == 2);
+	REQUIRE(screen.pick({ 2, 0 }).look.bg == color::rgb(100, 0, 0));
+	REQUIRE(screen.pick({ 3, 0 }).look.bg == color::rgb(0, 0, 100));
+
+	// the same pixels with other dimensions are another image
+	canvas.blit_image({ { 0, 0 }, { 2, 1 } }, rgb, 2, 4);
+	REQUIRE(canvas.cached_images() == 3);
+	REQUIRE(screen.pick({ 0, 0 }).look.bg == color::rgb(50, 0, 50));
+}
+
+TEST_CASE("Filtering rows", "Canvas::filter_rows") {
+	auto per_cell = [](Look &lk, UV uv) {
+		lk.fg = color::lerp(color::Red, color::Blue, uv.u);
+		lk.bg = color::rgb(std::uint8_t(uv.u*255.f), std::uint8_t(uv.v*255.f), 0);
+	};
+	// the same, a row at a time
+	auto per_row = [](std::span<Cell> cells, UV uv, float du) {
+		for(std::size_t idx = 0; idx < cells.size(); ++idx)
+		{
+			const auto u = std::min(1.f, uv.u + float(idx)*du);
+			cells[idx].look.fg = color::lerp(color::Red, color::Blue, u);
+			cells[idx].look.bg = color::rgb(std::uint8_t(u*255.f), std::uint8_t(uv.v*255.f), 0);
+		}
+	};
+
+	// partly off-screen, to the right and below
+	const Rectangle rect { { 6, 1 }, { 8, 5 } };
+
+	for(const auto recording: { false, true })
+	{
+		Screen cells(-1);
+		Screen rows(-1);
+		for(auto *screen: { &cells, &rows })
+		{
+			screen->set_size({ 10, 4 });
+			screen->clear(color::Green, color::Yellow);
+			screen->print({ 0, 2 }, "some text", color::White);
+			screen->set_recording(recording);
+		}
+
+		Canvas(cells).filter(rect, per_cell);
+		Canvas(rows).filter_rows(rect, per_row);
+
+		for(auto *screen: { &cells, &rows })
+			screen->set_recording(false);
+
+		for(std::size_t y = 0; y < 4; ++y)
+		{
+			for(std::size_t x = 0; x < 10; ++x)
+			{
+				INFO((recording? "recorded ": "") << x << ", " << y);
+				REQUIRE(rows.pick({ x, y }) == cells.pick({ x, y }));
+			}
+		}
+		// the on-screen part was filtered (with UV relative to the whole rectangle), nothing else
+		REQUIRE(cells.pick({ 6, 1 }).look.bg == color::rgb(std::uint8_t(255.f/8.f), std::uint8_t(255.f/5.f), 0));
+		REQUIRE(cells.pick({ 5, 1 }).look.bg == color::Green);
+		REQUIRE(cells.pick({ 6, 0 }).look.bg == color::Green);
+	}
+}
+
+// only has the per-sample function, i.e. uses the default sample_row()
+struct Stripes : public color::Sampler
+{
+	Color sample(UV uv, float) const override
+	{
+		return int(uv.u*7.f + uv.v*3.f) % 2? color::Red: color::Blue;
+	}
+};
+
+TEST_CASE("Sampling rows", "color::Sampler::sample_row") {
+	const color::Constant constant(color::Green);
+	color::LinearGradient gradient({ color::Black, color::Red, color::White });
+	const color::LinearGradient single({ color::Yellow });
+	const Stripes stripes;
+
+	const std::pair<const char *, const color::Sampler *> samplers[] {
+		{ "constant", &constant },
+		{ "gradient", &gradient },
+		{ "single color gradient", &single },
+		{ "default sample_row()", &stripes },
+	};
+
+	// rows like Canvas::fill() samples them: u & v in (0, 1], the last step possibly clamped
+	static constexpr std::size_t width { 37 };
+	static constexpr std::size_t height { 5 };
+	const auto du = 1.f / float(width);
+	const auto dv = 1.f / float(height);
+
+	for(const auto offset: { 0.f, 0.4f })
+	{
+		gradient.set_offset(offset);
+
+		for(const auto &[name, sampler]: samplers)
+		{
+			for(const auto angle: { 0.f, 33.f, 90.f, 180.f, 250.f, 300.f })
+			{
+				for(std::size_t row = 0; row < height; ++row)
+				{
+					const auto v = std::min(1.f, float(row + 1)*dv);
+					// also starting part-way, as for a clipped rectangle
+					for(const auto first: { 0ul, 12ul })
+					{
+						const auto u0 = float(first + 1)*du;
+
+						Color colors[width];
+						sampler->sample_row(v, u0, du, width - first, colors, angle);
+
+						for(std::size_t idx = 0; idx < width - first; ++idx)
+						{
+							const auto u = std::min(1.f, u0 + float(idx)*du);
+
+							INFO(name << ": angle " << angle << ", offset " << offset << ", v " << v << ", u " << u);
+							REQUIRE(colors[idx] == sampler->sample({ u, v }, angle));
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// exposes the lookup table and the exact interpolation of a gradient
+struct GradientLookup : public color::LinearGradient
+{
+	using LinearGradient::LinearGradient;
+	using LinearGradient::color_at;
+	using LinearGradient::interpolate;
+	using LinearGradient::lut_size;
+};
+
+TEST_CASE("Gradient lookup table", "color::LinearGradient") {
+	GradientLookup gradient({ color::Black, color::Red, color::White, color::Blue });
+
+	// half a table step, at most 3*255 per unit of 't' (three segments): well within one step per channel
+	static constexpr auto tolerance { 1 };
+
+	float offset { 0 };
+	auto check = [&gradient, &offset](float alpha, float scale) {
+		// the same arithmetic as the lookup, for the same wrapping
+		auto t = alpha*scale + offset;
+		t -= std::floor(t);
+
+		const auto looked_up = gradient.color_at(alpha, scale);
+		const auto exact = gradient.interpolate(t);
+
+		INFO("alpha " << alpha << ", scale " << scale << ", offset " << offset << ", t " << t);
+		REQUIRE(std::abs(int(color::red(looked_up)) - int(color::red(exact))) <= tolerance);
+		REQUIRE(std::abs(int(color::green(looked_up)) - int(color::green(exact))) <= tolerance);
+		REQUIRE(std::abs(int(color::blue(looked_up)) - int(color::blue(exact))) <= tolerance);
+	};
+
+	for(const auto o: { 0.f, 0.3f, -0.25f, 0.999f })
+	{
+		offset = o;
+		gradient.set_offset(offset);
+
+		for(const auto angle: { 0.f, 30.f, 45.f, 90.f, 135.f, 200.f, 315.f })
+		{
+			const auto radians = angle*std::numbers::pi_v<float>/180.f;
+			const auto scale = std::max(std::abs(std::sin(radians)), std::abs(std::cos(radians)));
+
+			for(auto step = 1; step < 2000; ++step)
+				check(float(step)/2000.f, scale);
+
+			// just below and above where 't' wraps around
+			const auto wrap_alpha = (1.f - offset + std::floor(offset))/scale;
+			for(const auto delta: { -1e-3f, -1e-5f, 1e-5f, 1e-3f })
+			{
+				if(wrap_alpha + delta > 0.f and wrap_alpha + delta < 1.f)
+					check(wrap_alpha + delta, scale);
+			}
+		}
+	}
+
+	// no colors at all
+	GradientLookup empty({});
+	REQUIRE(empty.sample({ 0.5f, 0.5f }, 0) == color::Default);
+}
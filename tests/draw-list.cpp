@@ -0,0 +1,137 @@
+#include <termic/canvas.h>
+#include <termic/parallel.h>
+#include <termic/screen.h>
+using namespace  termic;
+
+using namespace std::literals;
+
+#include <catch2/catch.hpp>
+
+
+// a gradient that counts how many cells it was asked for
+struct CountingSampler : public color::LinearGradient
+{
+	using LinearGradient::LinearGradient;
+
+	void sample_row(float v, float u0, float du, std::size_t count, Color *out, float angle) const override
+	{
+		samples += count;
+		LinearGradient::sample_row(v, u0, du, count, out, angle);
+	}
+
+	mutable std::size_t samples { 0 };
+};
+
+static void draw(Screen &screen, const color::Sampler &gradient)
+{
+	Canvas canvas(screen);
+
+	screen.clear();
+	canvas.fill(&gradient, 30);
+	screen.print({ 2, 1 }, "covered", { color::White, color::Black });
+	screen.print({ 0, 3 }, "利Ö|\tx", color::Red);
+	canvas.fade({ { 1, 0 }, { 6, 4 } }, color::NoChange, color::Black, 0.25f);
+	canvas.filter({ { 1, 0 }, { 6, 4 } }, [](Look &lk, UV uv) {
+		lk.fg = color::lerp(lk.fg, color::Blue, uv.u);
+	});
+	screen.clear({ { 10, 0 }, { 2, 5 } }, color::Green, color::Yellow);
+}
+
+TEST_CASE("Recording drawing commands", "DrawList") {
+	const color::LinearGradient gradient({ color::Black, color::Red, color::White });
+
+	Screen immediate(-1);
+	immediate.set_size({ 12, 5 });
+	draw(immediate, gradient);
+
+	Screen recorded(-1);
+	recorded.set_size({ 12, 5 });
+	recorded.set_recording(true);
+
+	CountingSampler counting({ color::Black, color::Red, color::White });
+	draw(recorded, counting);
+	REQUIRE(counting.samples == 0);  // nothing drawn yet
+
+	recorded.set_recording(false);
+
+	// cells completely covered by the print (and the last clear) aren't sampled
+	REQUIRE(counting.samples == 12*5 - 7 - 2*5);
+
+	for(std::size_t y = 0; y < 5; ++y)
+	{
+		for(std::size_t x = 0; x < 12; ++x)
+		{
+			const auto a = immediate.pick({ x, y });
+			const auto b = recorded.pick({ x, y });
+			INFO("at " << x << "," << y);
+			REQUIRE(a == b);
+		}
+	}
+}
+
+TEST_CASE("Recording commands that read cells", "DrawList") {
+	// the filter uses the fill's color, even though the print covers it afterwards
+	auto draw = [](Screen &screen) {
+		Canvas canvas(screen);
+
+		screen.clear();
+		canvas.fill({ { 0, 0 }, { 3, 1 } }, color::Red);
+		canvas.filter({ { 0, 0 }, { 3, 1 } }, [](Look &lk, UV) { lk.fg = lk.bg; });
+		screen.print({ 1, 0 }, "x", look::bg(color::Blue));
+	};
+
+	Screen immediate(-1);
+	immediate.set_size({ 4, 1 });
+	draw(immediate);
+	REQUIRE(immediate.pick({ 1, 0 }).look.fg == color::Red);
+
+	Screen recorded(-1);
+	recorded.set_size({ 4, 1 });
+	recorded.set_recording(true);
+	draw(recorded);
+	recorded.set_recording(false);
+
+	for(std::size_t x = 0; x < 4; ++x)
+		REQUIRE(recorded.pick({ x, 0 }) == immediate.pick({ x, 0 }));
+}
+
+TEST_CASE("Recording parallel drawing commands", "DrawList") {
+	// use threads even on a single CPU; the screen is large enough for several bands
+	parallel::set_concurrency(4);
+
+	const color::LinearGradient gradient({ color::Black, color::Red, color::White });
+	const Rectangle area { { 3, 2 }, { 90, 150 } };
+
+	auto draw = [&gradient, &area](Screen &screen) {
+		Canvas canvas(screen);
+
+		screen.clear();
+		canvas.fill(area, &gradient, 30, par);
+		screen.print({ 5, 40 }, "covered", { color::White, color::Black });
+		canvas.fade(area, color::NoChange, color::Black, 0.25f, par);
+		canvas.filter(area, [](Look &lk, UV uv) {
+			lk.fg = color::lerp(lk.fg, color::Blue, uv.v);
+		}, par);
+	};
+
+	Screen immediate(-1);
+	immediate.set_size({ 100, 160 });
+	draw(immediate);
+
+	Screen recorded(-1);
+	recorded.set_size({ 100, 160 });
+	recorded.set_recording(true);
+	draw(recorded);
+	recorded.set_recording(false);
+
+	for(std::size_t y = 0; y < 160; ++y)
+	{
+		for(std::size_t x = 0; x < 100; ++x)
+		{
+			if(immediate.pick({ x, y }) != recorded.pick({ x, y }))
+				FAIL("differs at " << x << "," << y);
+		}
+	}
+
+	parallel::set_concurrency(0);
+}
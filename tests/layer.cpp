@@ -0,0 +1,175 @@
+#include <termic/layer.h>
+#include <termic/screen.h>
+using namespace  termic;
+
+using namespace std::literals;
+
+#include <catch2/catch.hpp>
+
+#include <random>
+
+
+static std::string shown_row(const Screen &screen, std::size_t y)
+{
+	std::string row;
+	for(std::size_t x = 0; x < screen.size().width; ++x)
+	{
+		const auto cell = screen.shown({ x, y });
+		if(cell.width == 0)
+			continue;
+		row += cell.ch[0] == '\0'? " "sv: std::string_view(cell.ch);
+	}
+	return row;
+}
+
+TEST_CASE("Adding, moving, hiding and removing layers", "Layer") {
+	Screen screen(-1);
+	screen.set_size({ 12, 2 });
+	screen.clear();
+	screen.print({ 0, 0 }, "hello world!");
+	screen.print({ 0, 1 }, "second line.");
+	screen.update();
+	REQUIRE(shown_row(screen, 0) == "hello world!");
+
+	auto &layer = screen.add_layer({ { 2, 0 }, { 4, 2 } });
+	layer.print({ 1, 0 }, "AB", { color::Red, color::Black });
+	screen.update();
+
+	// undrawn cells of the layer are transparent
+	REQUIRE(shown_row(screen, 0) == "helAB world!");
+	REQUIRE(shown_row(screen, 1) == "second line.");
+	REQUIRE(screen.shown({ 3, 0 }).look.fg == color::Red);
+	REQUIRE(screen.shown({ 3, 0 }).look.bg == color::Black);
+	REQUIRE(screen.shown({ 2, 0 }).look == screen.pick({ 2, 0 }).look);
+
+	layer.move({ 6, 1 });
+	screen.update();
+	REQUIRE(shown_row(screen, 0) == "hello world!");
+	REQUIRE(shown_row(screen, 1) == "second ABne.");
+
+	layer.set_visible(false);
+	screen.update();
+	REQUIRE(shown_row(screen, 1) == "second line.");
+
+	layer.set_visible(true);
+	screen.update();
+	REQUIRE(shown_row(screen, 1) == "second ABne.");
+
+	screen.remove_layer(layer);
+	screen.update();
+	REQUIRE(shown_row(screen, 0) == "hello world!");
+	REQUIRE(shown_row(screen, 1) == "second line.");
+}
+
+TEST_CASE("Layer cells without content", "Layer") {
+	Screen screen(-1);
+	screen.set_size({ 6, 1 });
+	screen.clear();
+	screen.print({ 0, 0 }, "abcdef");
+
+	auto &layer = screen.add_layer({ { 0, 0 }, { 6, 1 } });
+	// only the look changes; the text below shows through
+	layer.set_cell({ 1, 0 }, Cell::NoChange, 1, { color::NoChange, color::Red, style::NoChange });
+	// blanked cells do cover the text
+	layer.clear({ { 3, 0 }, { 2, 1 } }, color::Blue);
+	screen.update();
+
+	REQUIRE(shown_row(screen, 0) == "abc  f");
+	REQUIRE(screen.shown({ 1, 0 }).look.bg == color::Red);
+	REQUIRE(screen.shown({ 3, 0 }).look.bg == color::Blue);
+}
+
+TEST_CASE("Layers over double-width characters", "Layer") {
+	Screen screen(-1);
+	screen.set_size({ 8, 2 });
+	screen.clear();
+	screen.print({ 0, 0 }, "利利利利");
+	screen.print({ 0, 1 }, "abcdefgh");
+
+	auto &layer = screen.add_layer({ { 0, 0 }, { 8, 2 } });
+	screen.update();
+	REQUIRE(shown_row(screen, 0) == "利利利利");
+
+	// inside the layer: covering one half of a character below blanks the other
+	layer.set_cell({ 3, 0 }, "x", 1);
+	screen.update();
+	REQUIRE(shown_row(screen, 0) == "利 x利利");
+	REQUIRE(screen.shown({ 2, 0 }).width == 1);
+
+	// a double-width character of the layer over two halves below
+	layer.print({ 5, 0 }, "字");
+	screen.update();
+	REQUIRE(shown_row(screen, 0) == "利 x 字 ");
+
+	// a double-width character of the layer partly covered by another layer
+	auto &top = screen.add_layer({ { 4, 1 }, { 2, 1 } }, 2);
+	layer.print({ 3, 1 }, "字");
+	top.set_cell({ 0, 0 }, "y", 1);
+	screen.update();
+	REQUIRE(shown_row(screen, 1) == "abc yfgh");
+	REQUIRE(shown_row(screen, 0) == "利 x 字 ");
+}
+
+TEST_CASE("Compositing layers incrementally", "Layer") {
+	// updates after each change produce the same output as a single update
+
+	std::mt19937 rng(1234);
+	auto random = [&rng](std::size_t n) { return std::uniform_int_distribution<std::size_t>(0, n - 1)(rng); };
+
+	static constexpr std::string_view texts[] { "ab", "利", "x字y", "Ö" };
+
+	for(auto round = 0; round < 50; ++round)
+	{
+		Screen incremental(-1);
+		Screen at_once(-1);
+
+		for(auto *screen: { &incremental, &at_once })
+		{
+			screen->set_size({ 16, 6 });
+			screen->clear();
+			for(std::size_t y = 0; y < 6; ++y)
+				screen->print({ y % 2, y }, "利字abcdef利字利");
+		}
+		incremental.update();
+
+		Layer *layers[2][2];
+		for(auto idx = 0; idx < 2; ++idx)
+		{
+			layers[0][idx] = &incremental.add_layer({ { std::size_t(idx*3), 1 }, { 7, 3 } }, idx);
+			layers[1][idx] = &at_once.add_layer({ { std::size_t(idx*3), 1 }, { 7, 3 } }, idx);
+		}
+
+		for(auto step = 0; step < 20; ++step)
+		{
+			const auto idx = random(2);
+			const auto op = random(4);
+			const Pos pos { random(8), random(4) };
+			const auto text = texts[random(std::size(texts))];
+			const auto content = random(2)? Cell::NoChange: "z"sv;
+			const Look lk { color::NoChange, random(2)? color::Blue: color::NoChange, style::NoChange };
+
+			for(auto s = 0; s < 2; ++s)
+			{
+				auto &layer = *layers[s][idx];
+				switch(op)
+				{
+				case 0: layer.print(pos, text, lk); break;
+				case 1: layer.set_cell(pos, content, 1, lk); break;
+				case 2: layer.move(pos); break;
+				case 3: layer.clear({ pos, { 2, 1 } }, color::Green); break;
+				}
+			}
+			incremental.update();
+		}
+		at_once.update();
+
+		for(std::size_t y = 0; y < 6; ++y)
+		{
+			for(std::size_t x = 0; x < 16; ++x)
+			{
+				INFO("round " << round << ": " << x << ", " << y);
+				REQUIRE(incremental.shown({ x, y }) == at_once.shown({ x, y }));
+			}
+		}
+	}
+}
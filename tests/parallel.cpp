@@ -0,0 +1,51 @@
+#include <termic/parallel.h>
+using namespace  termic;
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+
+TEST_CASE("Splitting rows into bands", "parallel::for_bands") {
+	// use threads even on a single CPU
+	parallel::set_concurrency(4);
+	REQUIRE(parallel::concurrency() == 4);
+
+	std::vector<int> rows(1000, 0);
+
+	parallel::for_bands(rows.size(), 10, [&rows](std::size_t first, std::size_t last) {
+		for(auto row = first; row < last; ++row)
+			++rows[row];
+	});
+	REQUIRE(std::count(rows.begin(), rows.end(), 1) == 1000);
+
+	// too few rows for more than one band
+	std::atomic<int> calls { 0 };
+	parallel::for_bands(rows.size(), 1000, [&calls](std::size_t first, std::size_t last) {
+		REQUIRE(first == 0);
+		REQUIRE(last == 1000);
+		++calls;
+	});
+	REQUIRE(calls == 1);
+
+	// one band per thread
+	std::atomic<int> bands { 0 };
+	parallel::for_bands(rows.size(), 10, [&bands](std::size_t, std::size_t) { ++bands; });
+	REQUIRE(bands == 4);
+
+	// nested calls (on the pool's threads, and on the calling thread) run serially instead of waiting for the pool
+	std::atomic<std::size_t> total { 0 };
+	std::atomic<int> nested_calls { 0 };
+	parallel::for_bands(100, 1, [&total, &nested_calls](std::size_t first, std::size_t last) {
+		parallel::for_bands(last - first, 1, [&total, &nested_calls](std::size_t f, std::size_t l) {
+			total += l - f;
+			++nested_calls;
+		});
+	});
+	REQUIRE(total == 100);
+	REQUIRE(nested_calls == 4);
+
+	parallel::set_concurrency(0);
+}
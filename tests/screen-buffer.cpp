@@ -0,0 +1,331 @@
+#include <termic/screen-buffer.h>
+#include <termic/pixel-canvas.h>
+#include <termic/region.h>
+#include <termic/tiled-buffer.h>
+using namespace  termic;
+
+using namespace std::literals;
+
+#include <catch2/catch.hpp>
+
+
+TEST_CASE("Clearing a screen buffer", "ScreenBuffer::clear") {
+	ScreenBuffer buf;
+	buf.set_size({ 4, 3 });
+
+	buf.set_cell({ 1, 1 }, "x", 1, { color::Red, color::Blue });
+	REQUIRE(buf.cell({ 1, 1 }).ch == "x"sv);
+
+	buf.clear(color::Green, color::White);
+	{
+		const auto &cbuf = buf;
+		REQUIRE(cbuf.cell({ 1, 1 }).ch == ""sv);
+		REQUIRE(cbuf.cell({ 1, 1 }).look.bg == color::Green);
+		REQUIRE(cbuf.cell({ 3, 2 }).look.fg == color::White);
+	}
+
+	buf.set_cell({ 2, 2 }, "y", 1, look::Default);
+	REQUIRE(buf.cell({ 2, 2 }).ch == "y"sv);
+	REQUIRE(buf.cell({ 2, 2 }).look.bg == color::Green);  // look::Default doesn't change background
+	REQUIRE(buf.cell({ 0, 2 }).ch == ""sv);
+	REQUIRE(buf.cell({ 0, 2 }).look.bg == color::Green);
+
+	// partial clear keeps the foreground
+	buf.clear(color::Blue, color::NoChange, false);
+	REQUIRE(buf.cell({ 2, 2 }).ch == "y"sv);
+	REQUIRE(buf.cell({ 2, 2 }).look.bg == color::Blue);
+	REQUIRE(buf.cell({ 0, 0 }).look.fg == color::White);
+}
+
+TEST_CASE("Copying a cleared screen buffer", "ScreenBuffer::operator =") {
+	ScreenBuffer a;
+	ScreenBuffer b;
+	a.set_size({ 3, 2 });
+	b.set_size({ 3, 2 });
+
+	a.set_cell({ 0, 0 }, "a", 1, { color::Red, color::Blue });
+	b = a;
+	a.clear(color::Black, color::Black);
+	REQUIRE(b.cell({ 0, 0 }).ch == "a"sv);
+
+	b = a;
+	REQUIRE(b.cell({ 0, 0 }) == a.cell({ 0, 0 }));
+	REQUIRE(b.cell({ 0, 0 }).look.bg == color::Black);
+}
+
+TEST_CASE("Resizing a cleared screen buffer", "ScreenBuffer::set_size") {
+	ScreenBuffer buf;
+	buf.preserve_content = true;
+	buf.set_size({ 3, 2 });
+	buf.clear(color::Red, color::White);
+	buf.set_size({ 5, 3 });
+
+	REQUIRE(buf.cell({ 2, 1 }).look.bg == color::Red);
+	REQUIRE(buf.cell({ 4, 2 }).look.bg == color::Default);
+}
+
+TEST_CASE("Filling rectangles of a screen buffer", "ScreenBuffer::set_cells") {
+	ScreenBuffer buf;
+	buf.set_size({ 6, 4 });
+	buf.clear(color::Black, color::White);
+	buf.set_cell({ 2, 1 }, "a", 1, { color::Red, style::Bold, color::Blue });
+
+	// only the background (and width) is set
+	buf.set_cells({ { 1, 1 }, { 3, 2 } }, Cell::NoChange, 1, look::bg(color::Green));
+	REQUIRE(buf.cell({ 2, 1 }).ch == "a"sv);
+	REQUIRE(buf.cell({ 2, 1 }).look.fg == color::Red);
+	REQUIRE(buf.cell({ 2, 1 }).look.style == style::Bold);
+	REQUIRE(buf.cell({ 2, 1 }).look.bg == color::Green);
+	REQUIRE(buf.cell({ 3, 2 }).look.bg == color::Green);
+	REQUIRE(buf.cell({ 4, 2 }).look.bg == color::Black);
+	REQUIRE(buf.cell({ 0, 1 }).look.bg == color::Black);
+
+	// clipped to the buffer
+	buf.set_cells({ { 4, 3 }, { 10, 10 } }, "z", 1, { color::Yellow, color::Purple });
+	REQUIRE(buf.cell({ 5, 3 }).ch == "z"sv);
+	REQUIRE(buf.cell({ 5, 3 }).look == Look(color::Yellow, color::Purple));
+	REQUIRE(buf.cell({ 3, 3 }).ch == ""sv);
+
+	// clusters too long for a cell are cut between codepoints
+	buf.set_cells({ { 0, 0 }, { 2, 1 } }, "a\u0301\u0301\u0301\u0301\u0301\u0301\u0301", 1, look::Default);
+	REQUIRE(buf.cell({ 1, 0 }).ch == "a\u0301\u0301\u0301\u0301\u0301\u0301"sv);
+
+	buf.clear({ { 0, 1 }, { 6, 1 } }, color::NoChange, color::Blue, false);
+	REQUIRE(buf.cell({ 2, 1 }).ch == "a"sv);
+	REQUIRE(buf.cell({ 2, 1 }).look.fg == color::Blue);
+	REQUIRE(buf.cell({ 2, 1 }).look.style == style::Default);
+	REQUIRE(buf.cell({ 2, 1 }).look.bg == color::Green);
+}
+
+TEST_CASE("Fading colors", "ScreenBuffer::fade") {
+	REQUIRE(color::mix(color::White, color::Black, 0) == color::White);
+	REQUIRE(color::mix(color::White, color::Black, 256) == color::Black);
+	REQUIRE(color::mix(color::rgb(200, 100, 0), color::rgb(0, 100, 200), 128) == color::rgb(100, 100, 100));
+	REQUIRE(color::lerp(color::Red, color::Blue, 0.5f) == color::rgb(127, 0, 127));
+
+	ScreenBuffer buf;
+	buf.set_size({ 4, 3 });
+	buf.clear(color::White, color::White);
+	buf.set_cell({ 1, 1 }, "x", 1, { color::Red, color::Red });
+
+	buf.fade({ { 0, 0 }, buf.size() }, color::NoChange, color::Black, 0.5f);
+	const auto &cbuf = buf;
+	REQUIRE(cbuf.cell({ 3, 2 }).look.bg == color::rgb(127, 127, 127));
+	REQUIRE(cbuf.cell({ 3, 2 }).look.fg == color::White);
+	REQUIRE(cbuf.cell({ 1, 1 }).look.bg == color::rgb(127, 0, 0));
+	REQUIRE(cbuf.cell({ 1, 1 }).look.fg == color::Red);
+
+	buf.fade({ { 0, 0 }, { 1, 1 } }, color::Black, color::NoChange, 1.f);
+	REQUIRE(cbuf.cell({ 0, 0 }).look.fg == color::Black);
+	REQUIRE(cbuf.cell({ 1, 0 }).look.fg == color::White);
+}
+
+TEST_CASE("Compositing translucent colors", "color::Rgba") {
+	REQUIRE(color::rgba(color::White, 0.5f).c == color::rgb(128, 128, 128));
+	REQUIRE(color::over(color::rgba(color::Red, 1.f), color::Blue) == color::Red);
+	REQUIRE(color::over(color::rgba(color::Red, 0.f), color::Blue) == color::Blue);
+	REQUIRE(color::over(color::rgba(color::NoChange, 1.f), color::Blue) == color::Blue);
+	REQUIRE(color::over(color::rgba(color::White, 0.5f), color::Black) == color::rgb(128, 128, 128));
+	REQUIRE(color::over(color::rgba(color::Black, 0.5f), color::White) == color::rgb(127, 127, 127));
+
+	ScreenBuffer buf;
+	buf.set_size({ 6, 2 });
+	buf.clear(color::White, color::Black);
+	buf.print({ 0, 0 }, "ab利", { color::Black, color::White });
+
+	// a shadow: darkens both the text and the background, but keeps the text
+	buf.composite({ { 0, 0 }, { 2, 1 } }, color::rgba(color::Black, 0.5f), color::rgba(color::Black, 0.5f));
+	REQUIRE(buf.cell({ 0, 0 }).ch == "a"sv);
+	REQUIRE(buf.cell({ 0, 0 }).look.bg == color::rgb(127, 127, 127));
+	REQUIRE(buf.cell({ 2, 0 }).look.bg == color::White);
+
+	ScreenBuffer popup;
+	popup.set_size({ 2, 1 });
+	popup.clear(color::Blue, color::White);
+	popup.print({ 0, 0 }, "x", look::Default);
+
+	// text is copied only where the source has some; it splits the wide character below it
+	buf.blit(popup, { { 0, 0 }, popup.size() }, { 1, 1 }, 0.5f);
+	buf.blit(popup, { { 0, 0 }, popup.size() }, { 3, 0 }, 0.5f);
+	REQUIRE(buf.cell({ 1, 1 }).ch == "x"sv);
+	REQUIRE(buf.cell({ 1, 1 }).look.bg == color::rgb(127, 127, 255));
+	REQUIRE(buf.cell({ 2, 1 }).ch == ""sv);
+	REQUIRE(buf.cell({ 3, 0 }).ch == "x"sv);
+	REQUIRE(buf.cell({ 2, 0 }).ch == ""sv);
+	REQUIRE(buf.cell({ 2, 0 }).width == 1);
+}
+
+TEST_CASE("Drawing pixels", "PixelCanvas") {
+	ScreenBuffer buf;
+	buf.set_size({ 4, 2 });
+	buf.clear(color::Black, color::White);
+
+	PixelCanvas half({ 3, 1 });
+	REQUIRE(half.size() == Size{ 3, 2 });
+	half.set_pixel({ 0, 0 }, color::Red);
+	half.set_pixel({ 1, 1 }, color::Blue);
+	half.draw(buf, { 1, 0 });
+
+	REQUIRE(buf.cell({ 1, 0 }).ch == "▀"sv);
+	REQUIRE(buf.cell({ 1, 0 }).look.fg == color::Red);
+	REQUIRE(buf.cell({ 1, 0 }).look.bg == color::Black);
+	REQUIRE(buf.cell({ 2, 0 }).look.bg == color::Blue);
+	REQUIRE(buf.cell({ 3, 0 }).ch == " "sv);
+
+	// only changed cells are converted again
+	buf.set_cell({ 1, 0 }, "x", 1);
+	buf.set_cell({ 2, 0 }, "y", 1);
+	half.set_pixel({ 1, 1 }, color::Green);
+	half.draw(buf, { 1, 0 });
+	REQUIRE(buf.cell({ 1, 0 }).ch == "x"sv);
+	REQUIRE(buf.cell({ 2, 0 }).ch == "▀"sv);
+	REQUIRE(buf.cell({ 2, 0 }).look.bg == color::Green);
+
+	// ...unless the buffer was cleared since
+	buf.clear();
+	half.draw(buf, { 1, 0 });
+	REQUIRE(buf.cell({ 1, 0 }).ch == "▀"sv);
+
+	PixelCanvas braille({ 1, 1 }, PixelCanvas::Braille);
+	REQUIRE(braille.size() == Size{ 2, 4 });
+	braille.set_pixel({ 0, 0 }, color::White);
+	braille.set_pixel({ 1, 3 }, color::White);
+	braille.draw(buf, { 0, 1 });
+	REQUIRE(buf.cell({ 0, 1 }).ch == "⢁"sv);  // dots 1 & 8
+	REQUIRE(buf.cell({ 0, 1 }).look.fg == color::White);
+	REQUIRE(buf.cell({ 0, 1 }).look.bg == color::Black);
+
+	// rows outside the canvas are empty, like pixels outside it are ignored
+	REQUIRE(braille.row(3).size() == 2);
+	REQUIRE(braille.row(4).empty());
+	REQUIRE(half.row(100).empty());
+}
+
+TEST_CASE("Sparse tiled buffer", "TiledBuffer") {
+	TiledBuffer tiled({ 5000, 20000 });
+	REQUIRE(tiled.allocated_tiles() == 0);
+	REQUIRE(tiled.cell({ 4999, 19999 }).ch == ""sv);
+
+	tiled.set_cell({ 63, 100 }, "a", 1, { color::Red, color::Blue });
+	tiled.set_cell({ 64, 100 }, "b", 1, { color::Red, color::Blue });
+	tiled.set_cell({ 65, 100 }, "隊", 2, color::Green);
+	REQUIRE(tiled.allocated_tiles() == 2);
+
+	// only the viewed bytes are copied
+	tiled.set_cell({ 66, 100 }, "xyz"sv.substr(0, 1), 1, color::Green);
+	REQUIRE(tiled.cell({ 66, 100 }).ch == "x"sv);
+	tiled.set_cell({ 67, 100 }, "a\u0301\u0301\u0301\u0301\u0301\u0301\u0301", 1, color::Green);
+	REQUIRE(tiled.cell({ 67, 100 }).ch == "a\u0301\u0301\u0301\u0301\u0301\u0301"sv);
+
+	ScreenBuffer buf;
+	buf.set_size({ 4, 2 });
+	buf.clear(color::Black, color::White);
+
+	// viewport spanning two tiles; the wide character is cut by the right edge
+	tiled.blit(buf, { { 62, 100 }, { 10, 10 } }, { 0, 1 });
+	REQUIRE(buf.cell({ 0, 1 }).ch == ""sv);
+	REQUIRE(buf.cell({ 1, 1 }).ch == "a"sv);
+	REQUIRE(buf.cell({ 1, 1 }).look.bg == color::Blue);
+	REQUIRE(buf.cell({ 2, 1 }).ch == "b"sv);
+	REQUIRE(buf.cell({ 3, 1 }).ch == ""sv);
+	REQUIRE(buf.cell({ 3, 1 }).width == 1);
+	REQUIRE(buf.cell({ 0, 0 }).look.bg == color::Black);
+}
+
+TEST_CASE("Printing into an off-screen buffer", "ScreenBuffer::print") {
+	ScreenBuffer buf;
+	buf.set_size({ 10, 3 });
+	buf.clear();
+
+	Pos end { 0, 0 };
+	REQUIRE(buf.print({ 1, 0 }, "ab\n隊c", color::Red, &end) == 3);
+	REQUIRE(buf.cell({ 1, 0 }).ch == "a"sv);
+	REQUIRE(buf.cell({ 1, 1 }).ch == "隊"sv);
+	REQUIRE(buf.cell({ 1, 1 }).width == 2);
+	REQUIRE(buf.cell({ 2, 1 }).width == 0);
+	REQUIRE(buf.cell({ 3, 1 }).ch == "c"sv);
+	REQUIRE(end.x == 4);
+	REQUIRE(end.y == 1);
+
+	// long ASCII runs are clipped at the edge, and mix with other characters
+	REQUIRE(buf.print({ 0, 2 }, "0123456é89abcdef", color::Red, &end) == 10);
+	REQUIRE(buf.cell({ 6, 2 }).ch == "6"sv);
+	REQUIRE(buf.cell({ 7, 2 }).ch == "é"sv);
+	REQUIRE(buf.cell({ 9, 2 }).ch == "9"sv);
+	REQUIRE(buf.cell({ 9, 2 }).look.fg == color::Red);
+	REQUIRE(end.x == 10);
+
+	// grapheme clusters take a single cell (or two)
+	REQUIRE(buf.print({ 0, 2 }, "noe\u0308l 🇸🇪!", color::Red, &end) == 8);
+	REQUIRE(buf.cell({ 2, 2 }).ch == "e\u0308"sv);
+	REQUIRE(buf.cell({ 3, 2 }).ch == "l"sv);
+	REQUIRE(buf.cell({ 5, 2 }).ch == "🇸🇪"sv);
+	REQUIRE(buf.cell({ 5, 2 }).width == 2);
+	REQUIRE(buf.cell({ 7, 2 }).ch == "!"sv);
+}
+
+TEST_CASE("Blitting between screen buffers", "ScreenBuffer::blit") {
+	ScreenBuffer panel;
+	panel.set_size({ 4, 2 });
+	panel.clear(color::Blue, color::White);
+	panel.print({ 0, 0 }, "x隊y", look::Default);
+
+	ScreenBuffer buf;
+	buf.set_size({ 6, 3 });
+	buf.clear(color::Black, color::White);
+
+	buf.blit(panel, { { 0, 0 }, panel.size() }, { 3, 1 });
+	REQUIRE(buf.cell({ 3, 1 }).ch == "x"sv);
+	REQUIRE(buf.cell({ 3, 1 }).look.bg == color::Blue);
+	REQUIRE(buf.cell({ 4, 1 }).ch == "隊"sv);
+	REQUIRE(buf.cell({ 5, 1 }).width == 0);
+	REQUIRE(buf.cell({ 3, 2 }).look.bg == color::Blue);  // lazily cleared row in 'panel'
+	REQUIRE(buf.cell({ 2, 1 }).look.bg == color::Black);
+
+	// source rectangle starting in the middle of the wide character
+	buf.blit(panel, { { 2, 0 }, { 2, 1 } }, { 0, 0 });
+	REQUIRE(buf.cell({ 0, 0 }).ch == ""sv);
+	REQUIRE(buf.cell({ 0, 0 }).width == 1);
+	REQUIRE(buf.cell({ 1, 0 }).ch == "y"sv);
+
+	// overlapping, within the same buffer
+	buf.blit(buf, { { 3, 1 }, { 3, 1 } }, { 2, 1 });
+	REQUIRE(buf.cell({ 2, 1 }).ch == "x"sv);
+	REQUIRE(buf.cell({ 3, 1 }).ch == "隊"sv);
+	REQUIRE(buf.cell({ 4, 1 }).width == 0);
+	REQUIRE(buf.cell({ 5, 1 }).width == 1);  // orphaned right half
+}
+
+TEST_CASE("Drawing in regions", "Region") {
+	ScreenBuffer buf;
+	buf.set_size({ 12, 4 });
+	buf.clear();
+
+	Region panel(buf, { { 2, 1 }, { 6, 2 } });
+	REQUIRE(panel.print({ 1, 0 }, "clipped text\nab", color::Red) == 5);
+	REQUIRE(buf.cell({ 3, 1 }).ch == "c"sv);
+	REQUIRE(buf.cell({ 7, 1 }).ch == "p"sv);
+	REQUIRE(buf.cell({ 8, 1 }).ch == ""sv);
+	REQUIRE(buf.cell({ 3, 2 }).ch == "a"sv);
+
+	// nested, relative to the parent
+	auto inner = panel.region(Geometry{ .x = { 0.5f }, .y = {}, .width = { 0.5f }, .height = { 0.f, 1 } });
+	REQUIRE(inner.rect().top_left.x == 5);
+	REQUIRE(inner.rect().top_left.y == 1);
+	REQUIRE(inner.size().width == 3);
+	REQUIRE(inner.size().height == 1);
+
+	inner.clear(color::Blue);
+	REQUIRE(buf.cell({ 5, 1 }).look.bg == color::Blue);
+	REQUIRE(buf.cell({ 7, 1 }).look.bg == color::Blue);
+	REQUIRE(buf.cell({ 8, 1 }).look.bg == color::Default);
+	REQUIRE(buf.cell({ 5, 2 }).look.bg == color::Default);
+
+	// a wide character that doesn't fit blanks what was there
+	inner.print(Left, { 0, 0 }, "XXX");
+	REQUIRE(buf.cell({ 7, 1 }).ch == "X"sv);
+	inner.print(Left, { 0, 0 }, "xy隊");
+	REQUIRE(buf.cell({ 6, 1 }).ch == "y"sv);
+	REQUIRE(buf.cell({ 7, 1 }).ch == " "sv);
+	REQUIRE(buf.cell({ 7, 1 }).width == 1);
+}
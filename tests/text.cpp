@@ -90,3 +90,276 @@ TEST_CASE("Substring of UTF-8 strings", "text::substr") {
 		REQUIRE(text::substr(s, 1, 2) == "ぎや");
 	}
 }
+
+TEST_CASE("Editing long UTF-8 strings", "utf8::string") {
+	std::string expected;
+	for(auto idx = 0; idx < 100; ++idx)
+		expected += "aé隊";
+
+	utf8::string s { expected };
+	REQUIRE(s.size() == 300);
+	REQUIRE(s.substr(298, 5) == "é隊");
+	REQUIRE(s.byte_offset(200) == 66*6 + 3);
+
+	// edits far from the start keep the index in sync
+	s.insert(250, "ñ😀");
+	REQUIRE(s.size() == 302);
+	REQUIRE(s.substr(249, 4) == "añ😀é");
+	REQUIRE(s.substr(290, 1) == "a");
+
+	s.erase(10, 200);
+	REQUIRE(s.size() == 102);
+	REQUIRE(s.substr(9, 2) == "aa");
+	REQUIRE(s.substr(49, 4) == "añ😀é");
+	REQUIRE(s.substr(101) == "隊");
+}
+
+TEST_CASE("Documents", "text::Document") {
+	std::string expected;
+	for(auto idx = 0; idx < 500; ++idx)
+		expected += fmt::format("line {} of the document\n", idx);
+
+	text::Document doc { expected };
+	REQUIRE(doc.size() == expected.size());
+	REQUIRE(doc.lines() == 501);
+	REQUIRE(doc.line(0) == "line 0 of the document");
+	REQUIRE(doc.line(321) == "line 321 of the document");
+	REQUIRE(doc.line(500) == "");
+	REQUIRE(doc.line_of(doc.line_start(321) + 5) == 321);
+
+	// copies are snapshots
+	const auto snapshot = doc;
+
+	doc.insert(doc.line_start(100), "inserted\nlines\n");
+	doc.erase(doc.line_start(3), doc.line_start(5) - doc.line_start(3));
+	REQUIRE(doc.lines() == 501);
+	REQUIRE(doc.line(3) == "line 5 of the document");
+	REQUIRE(doc.line(98) == "inserted");
+	REQUIRE(doc.line(100) == "line 100 of the document");
+
+	REQUIRE(snapshot.str() == expected);
+
+	std::vector<std::string> visual;
+	doc.visual_lines(98, 12, [&visual](std::size_t line, std::string_view text, bool) {
+		visual.emplace_back(fmt::format("{}:{}", line, text));
+		return visual.size() < 5;
+	});
+	REQUIRE(visual == std::vector<std::string>{ "98:inserted", "99:lines", "100:line 100 of", "100:the document", "101:line 101 of" });
+
+	// a line split across chunks is wrapped as one
+	const text::Document split { std::string(1010, 'x') + "\n  crossing the chunk edge" };
+	auto pieces { 0 };
+	split.chunks(split.line_start(1), std::string::npos, [&pieces](std::string_view) { ++pieces; });
+	REQUIRE(pieces == 2);
+
+	visual.clear();
+	split.visual_lines(1, 12, [&visual](std::size_t line, std::string_view text, bool) {
+		visual.emplace_back(fmt::format("{}:{}", line, text));
+		return true;
+	});
+	REQUIRE(visual == std::vector<std::string>{ "1:crossing the", "1:chunk edge" });
+}
+
+TEST_CASE("Character widths", "utf8::width") {
+	REQUIRE(utf8::width(U'a') == 1);
+	REQUIRE(utf8::width(U' ') == 1);
+	REQUIRE(utf8::width(0) == 0);
+	REQUIRE(utf8::width(U'\n') == -1);
+	REQUIRE(utf8::width(0x7f) == -1);
+	REQUIRE(utf8::width(U'é') == 1);
+	REQUIRE(utf8::width(0x0301) == 0);  // combining acute accent
+	REQUIRE(utf8::width(0x200b) == 0);  // zero width space
+	REQUIRE(utf8::width(0x00ad) == 1);  // soft hyphen
+	REQUIRE(utf8::width(U'隊') == 2);
+	REQUIRE(utf8::width(U'Ｗ') == 2);  // fullwidth
+	REQUIRE(utf8::width(0x1f600) == 2);  // emoji
+	REQUIRE(text::width("a隊😀") == 5);
+
+	REQUIRE(utf8::ascii_run("plain ascii, then: é") == 19);
+	REQUIRE(utf8::ascii_run("tab\t") == 3);
+	REQUIRE(utf8::ascii_run("0123456789abcdef\x7f") == 16);
+	REQUIRE(text::width("a longer line of ASCII with\tcontrols and ü in it") == 47);
+}
+
+TEST_CASE("Decoding invalid UTF-8", "utf8::decode") {
+	REQUIRE(utf8::decode("plain ascii text, é") == U"plain ascii text, é");
+	REQUIRE(utf8::decode("a\xc3\xa9\xe2\x82") == U"aé�");           // truncated at the end
+	REQUIRE(utf8::decode("\xc0\xaf") == U"��");                 // overlong
+	REQUIRE(utf8::decode("\xed\xa0\x80x") == U"���x");     // surrogate
+	REQUIRE(utf8::decode("\xf4\x90\x80\x80") == U"����");  // > U+10FFFF
+	REQUIRE(utf8::decode("\xe2\x28\xa1") == U"�(�");            // bad continuation
+
+	REQUIRE(utf8::is_valid("隊 \xef\xbf\xbd 😀"));
+	REQUIRE(not utf8::is_valid("0123456789\xff"));
+
+	// iteration always gets to the end
+	std::u32string codepoints;
+	const std::string_view truncated { "ab\xe2\x82" };
+	for(auto iter = utf8::begin(truncated, false); iter != utf8::end(truncated); ++iter)
+		codepoints += iter->codepoint;
+	REQUIRE(codepoints == U"ab�");
+
+	REQUIRE(text::width("x\xe2\x82") == 2);
+}
+
+TEST_CASE("Grapheme clusters", "utf8::read_cluster") {
+	auto cluster = [](std::string_view s) { return utf8::read_cluster(s).sequence; };
+
+	REQUIRE(cluster("ab") == "a"sv);
+	REQUIRE(cluster("e\u0301\u0323x") == "e\u0301\u0323"sv);     // combining marks
+	REQUIRE(cluster("\r\nx") == "\r\n"sv);
+	REQUIRE(cluster("\u1100\u1161\u11a8x") == "\u1100\u1161\u11a8"sv);  // hangul jamo
+	REQUIRE(cluster("🇯🇵🇸🇪") == "🇯🇵"sv);                          // flags are pairs
+	REQUIRE(cluster("👩\u200d🚀!") == "👩\u200d🚀"sv);             // ZWJ sequence
+	REQUIRE(cluster("a\u200d🚀") == "a\u200d"sv);                  // ZWJ only joins pictographs
+	REQUIRE(cluster("\xff\u0301") == "\xff"sv);                   // invalid input is on its own
+	REQUIRE(utf8::is_invalid(utf8::read_cluster("\xff\u0301")));
+
+	REQUIRE(utf8::read_cluster("e\u0301").width == 1);
+	REQUIRE(utf8::read_cluster("🇯🇵").width == 2);
+	REQUIRE(utf8::read_cluster("❤\ufe0f").width == 2);            // emoji presentation
+	REQUIRE(utf8::read_cluster("👨\u200d👩\u200d👧").width == 2);
+	REQUIRE(utf8::read_cluster("\u0301").width == 0);
+	REQUIRE(text::width("Zoe\u0308 👍\U0001f3fd") == 6);
+}
+
+TEST_CASE("Wrapping text", "text::lines") {
+	const std::string_view s { "a well-known  saying\nSupercalifragilistic 隊隊隊" };
+
+	std::vector<std::string> wrapped;
+	for(const auto &line: text::lines(s, 8))
+	{
+		wrapped.emplace_back(s.substr(line.start, line.end - line.start));
+		if(line.hyphen)
+			wrapped.back() += '-';
+		REQUIRE(line.width == text::width(wrapped.back()));
+	}
+	REQUIRE(wrapped == std::vector<std::string>{ "a well-", "known", "saying", "Superca-", "lifragi-", "listic", "隊隊隊" });
+	REQUIRE(text::wrap(s, 8) == wrapped);
+
+	// leading spaces are skipped, but the offsets are into the input
+	REQUIRE(text::wrap("  indented text", 8) == std::vector<std::string>{ "indented", "text" });
+	const auto words = text::words("  indented text", [](char32_t cp) { return utf8::width(cp); });
+	REQUIRE(words.size() == 2);
+	REQUIRE(words[0].start == 2);
+	REQUIRE(words[0].end == 10);
+	REQUIRE(words[1].start == 11);
+	REQUIRE(words[1].width == 4);
+
+	// a custom width function
+	auto narrow = [](char32_t) { return 1; };
+	auto count { 0 };
+	for(const auto &line: text::lines("隊隊隊隊", 2, text::WesternBreaks, narrow))
+	{
+		REQUIRE(line.width == 2);
+		++count;
+	}
+	REQUIRE(count == 2);
+}
+
+TEST_CASE("Caching layouts", "text::LayoutCache") {
+	const std::string_view s { "Some help text  that is\nre-wrapped when   the window is resized, Supercalifragilistic\n\n隊隊 隊" };
+
+	text::LayoutCache cache;
+	for(auto limit = 1ul; limit < 70; ++limit)
+	{
+		std::vector<text::Line> expected;
+		for(const auto &line: text::lines(s, limit))
+			expected.push_back(line);
+
+		const auto wrapped = cache.wrap(s, limit);
+		REQUIRE(wrapped.size() == expected.size());
+		for(std::size_t idx = 0; idx < expected.size(); ++idx)
+		{
+			REQUIRE(wrapped[idx].start == expected[idx].start);
+			REQUIRE(wrapped[idx].end == expected[idx].end);
+			REQUIRE(wrapped[idx].width == expected[idx].width);
+			REQUIRE(wrapped[idx].hyphen == expected[idx].hyphen);
+		}
+	}
+
+	// bounded by memory; the most recent is kept
+	text::LayoutCache small { 1024 };
+	std::vector<std::string> paragraphs;
+	for(auto idx = 0; idx < 50; ++idx)
+		paragraphs.push_back(fmt::format("paragraph number {} is here", idx));
+	for(const auto &p: paragraphs)
+		REQUIRE(small.wrap(p, 10).size() == 3);
+	REQUIRE(small.memory_used() <= 1024);
+}
+
+// codepoint indices where 's' can be broken
+static std::vector<std::size_t> break_points(std::string_view s, text::BreakMode brmode=text::WesternBreaks)
+{
+	std::vector<std::size_t> points;
+	text::LineBreaker breaker { brmode };
+
+	const auto codepoints = utf8::decode(s);
+	for(std::size_t idx = 0; idx < codepoints.size(); ++idx)
+	{
+		if(breaker.next(codepoints[idx]) != text::LineBreaker::NoBreak)
+			points.push_back(idx);
+	}
+	return points;
+}
+
+TEST_CASE("Line break opportunities", "text::LineBreaker") {
+	using points = std::vector<std::size_t>;
+
+	REQUIRE(break_points("Hello, world!") == points{ 7 });
+	REQUIRE(break_points("a (b) c") == points{ 2, 6 });           // not inside the parentheses
+	REQUIRE(break_points("well-known -5 $100 50%") == points{ 5, 11, 14, 19 });
+	REQUIRE(break_points("no break") == points{});           // no-break space
+	REQUIRE(break_points("éx y") == points{ 4 });            // combining mark
+	REQUIRE(break_points("a\nb\r\nc") == points{ 2, 5 });          // mandatory
+	REQUIRE(break_points("日本語です。") == points{ 1, 2, 3, 4 });  // not before the full stop
+	REQUIRE(break_points("「日本」") == points{ 2 });
+	REQUIRE(break_points("🇯🇵🇺🇸🇸") == points{ 2, 4 });               // flags are pairs of regional indicators
+	REQUIRE(break_points("👩‍💻👍🏽") == points{ 3 });                  // ZWJ sequence, emoji modifier
+
+	// small kana (CJ) only allow breaks before them in East Asian mode
+	REQUIRE(break_points("ァィ") == points{});
+	REQUIRE(break_points("ァィ", text::EastAsianBreaks) == points{ 1 });
+	REQUIRE(break_points("ภาษาไทย") == points{});
+	REQUIRE(break_points("ภาษาไทย", text::SouthEastAsianBreaks).size() > 1);
+
+	// wrapping uses them
+	std::vector<std::string> wrapped;
+	const std::string_view s { "東京都の天気は晴れ (25°C)." };
+	for(const auto &line: text::lines(s, 8))
+		wrapped.emplace_back(s.substr(line.start, line.end - line.start));
+	REQUIRE(wrapped == std::vector<std::string>{ "東京都の", "天気は晴", "れ", "(25°C)." });
+}
+
+TEST_CASE("Caching widths", "text::WidthCache") {
+	text::WidthCache cache;
+
+	REQUIRE(cache.width("plain") == 5);
+	REQUIRE(cache.width("隊長") == 4);
+	REQUIRE(cache.hits() == 0);
+	REQUIRE(cache.width("隊長") == 4);
+	REQUIRE(cache.hits() == 1);
+	REQUIRE(cache.width("plain") == 5);  // ASCII isn't cached
+	REQUIRE(cache.hits() == 1);
+
+	// a string that uses the same entry replaces it
+	const auto slot = [](std::string_view s) { return std::hash<std::string_view>{}(s) % text::WidthCache::num_entries; };
+	std::string other;
+	for(auto idx = 0; other.empty() or slot(other) != slot("隊長"); ++idx)
+		other = fmt::format("é{}", idx);
+	REQUIRE(cache.width(other) == other.size() - 1);
+	REQUIRE(cache.width("隊長") == 4);
+	REQUIRE(cache.hits() == 1);
+	REQUIRE(cache.width("隊長") == 4);
+	REQUIRE(cache.hits() == 2);
+
+	// many strings, some of which share entries
+	for(auto round = 0; round < 2; ++round)
+	{
+		for(auto idx = 0; idx < 1000; ++idx)
+		{
+			const auto s = fmt::format("é{}", std::string(std::size_t(idx % 300), '-'));
+			REQUIRE(cache.width(s) == std::size_t(idx % 300) + 1);
+		}
+	}
+}